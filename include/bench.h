@@ -0,0 +1,21 @@
+#pragma once
+
+/*
+ * bench.h
+ * define a benchmark type to collect frame times and draw counts.
+ * report min/median/p99 frame time and draws per second as json.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+typedef struct {
+    double *times;
+    int len, cap;
+    unsigned long draws;
+} bench;
+
+bench bench_create(int frames);
+void  bench_frame(bench *b, double seconds, unsigned long draws);
+void  bench_report(bench *b, FILE *fp);
+void  bench_destroy(bench *b);
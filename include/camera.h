@@ -3,10 +3,12 @@
 /*
  * camera.h
  * define a camera type and functions to operate on it.
+ * define a frustum type: the six clip planes of a view-projection matrix.
  */
 
 #include <cglm/mat4.h>
 #include <cglm/cam.h>
+#include <cglm/frustum.h>
 
 #define X 0
 #define Y 1
@@ -21,6 +23,12 @@ typedef struct {
     mat4 view;
 } camera;
 
+// left, right, bottom, top, near, far; normalized, pointing inwards
+typedef struct {
+    vec4 planes[6];
+} frustum;
+
 camera cam_create(vec3 pos, vec3 eulers);
 void   cam_update(camera *cam);
 void   cam_lookat(camera *cam, vec3 target);
+void   cam_frustum(mat4 viewProjection, frustum *f);
@@ -0,0 +1,34 @@
+#pragma once
+
+/*
+ * cull.h
+ * define a cullbounds type: world-space boxes stored as separate arrays of
+ * centre and extent components, so a frustum test checks 8 boxes at once
+ * with avx (4 with sse) and writes the indices that survive.
+ *
+ * the arrays are padded with boxes that are never visible, so the vector
+ * loops need no scalar tail. cull_frustumRange tests a slice, e.g. the
+ * boxes of one bvh leaf.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include <cglm/mat4.h>
+
+#include "camera.h"
+
+typedef struct {
+    float *cx, *cy, *cz;    // centres
+    float *ex, *ey, *ez;    // half extents
+    int len;
+    int cap;                // len rounded up to a multiple of 8
+} cullbounds;
+
+int  cull_create(cullbounds *b, int count);
+void cull_set(cullbounds *b, int i, const float center[3], const float extent[3]);
+void cull_setBox(cullbounds *b, int i, mat4 model, const float localMin[3], const float localMax[3]);
+int  cull_frustum(const cullbounds *b, const frustum *f, uint32_t *visible);
+int  cull_frustumRange(const cullbounds *b, const frustum *f, int first, int len, uint32_t *visible);
+void cull_destroy(cullbounds *b);
@@ -0,0 +1,51 @@
+#pragma once
+
+/*
+ * dds.h
+ * define the dds container headers and functions to read and write
+ * block-compressed mip chains (bc1/bc3 as dxt1/dxt5, bc7 through dx10).
+ * level data follows the headers, largest level first, tightly packed.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include <glad/glad.h>
+
+#define DDS_MAGIC 0x20534444    // "DDS "
+#define DDS_MAX_SIZE 65536      // larger sides are rejected when parsing
+
+#define DDS_FOURCC(a, b, c, d) ((uint32_t) (a) | ((uint32_t) (b) << 8) | ((uint32_t) (c) << 16) | ((uint32_t) (d) << 24))
+
+#define DXGI_FORMAT_BC1_UNORM 71
+#define DXGI_FORMAT_BC3_UNORM 77
+#define DXGI_FORMAT_BC7_UNORM 98
+
+typedef struct {
+    uint32_t size, flags, fourCC, rgbBitCount;
+    uint32_t rMask, gMask, bMask, aMask;
+} dds_pixelformat;
+
+typedef struct {
+    uint32_t size, flags, height, width;
+    uint32_t pitchOrLinearSize, depth, mipMapCount;
+    uint32_t reserved1[11];
+    dds_pixelformat ddspf;
+    uint32_t caps, caps2, caps3, caps4, reserved2;
+} dds_header;
+
+typedef struct {
+    uint32_t dxgiFormat, resourceDimension, miscFlag, arraySize, miscFlags2;
+} dds_header10;
+
+typedef struct {
+    GLenum format;          // compressed gl internal format
+    int width, height, levels;
+    int blockBytes;         // 8 for bc1, 16 for bc3/bc7
+    size_t dataOffset;      // first level, from the start of the file
+} ddsinfo;
+
+int    dds_parse(const unsigned char *data, size_t size, ddsinfo *info);
+size_t dds_levelSize(const ddsinfo *info, int level);
+int    dds_writeHeader(FILE *fp, const ddsinfo *info);
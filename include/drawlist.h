@@ -0,0 +1,64 @@
+#pragma once
+
+/*
+ * drawlist.h
+ * define a draw list type: a render queue of draw packets, each tagged with
+ * a 64-bit sort key. the list is radix sorted once per frame, then runs of
+ * packets sharing program, vertex array, texture and index type go to the
+ * gpu as a single glMultiDrawElementsIndirect call, so state only changes
+ * between runs.
+ *
+ * key layout, most significant first:
+ *   pass 4 | program 12 | vertex array 8 | material 16 | depth 24
+ * ids wider than their field just sort less tightly, merging compares the
+ * packets themselves.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include <glad/glad.h>
+
+#include <state.h>
+#include <stream.h>
+
+// matches the layout glMultiDrawElementsIndirect reads
+typedef struct {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint  baseVertex;
+    GLuint baseInstance;
+} drawcommand;
+
+typedef struct {
+    uint64_t key;
+    GLuint prog;
+    GLuint vao;
+    GLuint texture;         // bound to unit 0, 0 to leave the unit alone
+    GLenum mode;
+    GLenum indexType;
+    drawcommand cmd;
+} drawpacket;
+
+typedef struct {
+    drawpacket *packets;
+    uint64_t *keys;         // sort scratch: key, index pairs
+    uint32_t *order;
+    uint64_t *tmpKeys;
+    uint32_t *tmpOrder;
+    int len;
+    int cap;
+    stream commands;
+    unsigned long draws;    // packets drawn by the last flush
+    unsigned long batches;  // multi-draw calls made by the last flush
+} drawlist;
+
+uint64_t drawlist_key(unsigned int pass, GLuint prog, GLuint vao, unsigned int material, float depth);
+
+int  drawlist_create(drawlist *list, int maxDraws);
+void drawlist_begin(drawlist *list);
+int  drawlist_push(drawlist *list, const drawpacket *packet);
+void drawlist_flush(drawlist *list, glstate *gl);
+void drawlist_destroy(drawlist *list);
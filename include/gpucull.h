@@ -0,0 +1,56 @@
+#pragma once
+
+/*
+ * gpucull.h
+ * define a gpu-driven draw path: object transforms and bounds live in a
+ * storage buffer, a compute shader (shader/cull.glsl) tests them against
+ * the frustum of the current FrameData and appends an indirect draw
+ * command plus instance matrix for each visible one, and a single
+ * glMultiDrawElementsIndirectCount draws whatever survived. the cpu never
+ * touches individual objects per frame.
+ *
+ * all objects draw from the index range they name in one mesh's buffers.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <glad/glad.h>
+#include <cglm/mat4.h>
+
+#include <mesh.h>
+#include <shader.h>
+#include <state.h>
+
+#define GPUCULL_OBJECT_BINDING  2
+#define GPUCULL_COMMAND_BINDING 3
+#define GPUCULL_VISIBLE_BINDING 4
+#define GPUCULL_COUNT_BINDING   5
+
+// std430 layout shared with cull.glsl
+typedef struct {
+    mat4 model;
+    vec4 boundsMin;         // local space, w unused
+    vec4 boundsMax;
+    GLuint indexCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint pad;
+} gpuobject;
+
+typedef struct {
+    GLuint vao;             // the mesh's vertices + visible matrices per instance
+    GLuint objects;
+    GLuint commands;
+    GLuint visible;
+    GLuint count;           // { drawCount, objectCount }, also the parameter buffer
+    GLenum indexType;
+    int len;
+    int capacity;
+} gpucull;
+
+int  gpucull_create(gpucull *gc, glstate *gl, const mesh *m, int capacity);
+void gpucull_upload(gpucull *gc, const gpuobject *objects, int count);
+void gpucull_cull(gpucull *gc, glstate *gl, program cull);
+void gpucull_draw(gpucull *gc, glstate *gl, program prog, GLuint texture);
+void gpucull_destroy(gpucull *gc);
@@ -0,0 +1,15 @@
+#pragma once
+
+/*
+ * imagealloc.h
+ * let stb_image decode straight into caller-owned memory, e.g. a mapped
+ * pixel unpack buffer. src/stb_image.c routes STBI_MALLOC/STBI_REALLOC/
+ * STBI_FREE through here: while a target is set on a thread, the first
+ * allocation of exactly its size gets the target instead of the heap, and
+ * freeing it is a no-op. callers compare the returned pixels with the
+ * target and copy if the decoder ended up somewhere else.
+ */
+
+#include <stdlib.h>
+
+void imagealloc_target(void *dst, size_t size);
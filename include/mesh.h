@@ -0,0 +1,59 @@
+#pragma once
+
+/*
+ * mesh.h
+ * define an indexed mesh type and functions to build one from a raw
+ * triangle list: duplicate vertices are welded, triangles reordered for
+ * the post-transform vertex cache and vertices reordered for fetch locality.
+ *
+ * meshes can be saved to a binary cache: a header followed by the packed
+ * vertex and index blobs, aligned so a memory-mapped file can be handed to
+ * glBufferStorage as is. the cache is native-endian and tied to its version.
+ * mesh_upload only packs with the given format if the mesh isn't packed yet.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <glad/glad.h>
+
+#include "vertex.h"
+
+#define MESH_MAGIC      0x4853454D  // "MESH"
+#define MESH_VERSION    1
+#define MESH_FILE_ALIGN 64
+
+typedef struct {
+    uint32_t magic, version;
+    uint32_t vertexCount, indexCount;
+    uint32_t indexType;
+    uint32_t position, texcoord, normal;
+    float posScale[3], posOffset[3];
+    uint64_t vertexOffset, indexOffset;
+} meshfile;
+
+typedef struct {
+    float *vertices;        // source floats, NULL when loaded from a cache
+    void *packed;           // vertices in the gpu-side format
+    void *indices;
+    int vertexCount, indexCount;
+    int stride;             // floats per vertex
+    GLenum indexType;       // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    vertexformat format;    // gpu-side layout, set when packed
+    float posScale[3];      // position = posOffset + posScale * stored
+    float posOffset[3];
+    void *mapping;          // the mapped cache file, if any
+    size_t mappingSize;
+    unsigned int VBO, EBO;
+} mesh;
+
+int    mesh_create(mesh *m, const float *vertices, int vertexCount, int stride);
+void   mesh_pack(mesh *m, vertexformat format);
+void   mesh_upload(mesh *m, vertexformat format);
+int    mesh_save(const mesh *m, const char *path);
+int    mesh_load(mesh *m, const char *path);
+size_t mesh_indexSize(const mesh *m);
+void   mesh_bounds(const mesh *m, float min[3], float max[3]);
+void   mesh_destroy(mesh *m);
@@ -0,0 +1,23 @@
+#pragma once
+
+/*
+ * mip.h
+ * build a full mip chain for an 8-bit image on the cpu with a 2x2 box
+ * filter, so the result is the same on every driver and never costs the
+ * render thread anything. an odd side takes 3 taps instead, weighted by
+ * coverage, so its last row or column still counts.
+ *
+ * the chain is tightly packed, largest level first: level 0 holds the
+ * image, the rest of the buffer (see mip_chainSize) is written. with srgb
+ * set, colour channels are averaged in linear light; alpha always is
+ * averaged as is. rows are split across the pool, if one is given.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "pool.h"
+
+int    mip_levelCount(int width, int height);
+size_t mip_chainSize(int width, int height, int channels);
+void   mip_generate(pool *p, unsigned char *chain, int width, int height, int channels, int srgb);
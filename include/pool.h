@@ -0,0 +1,42 @@
+#pragma once
+
+/*
+ * pool.h
+ * define a thread pool type: a fixed set of worker threads pulling jobs
+ * from a shared fifo queue.
+ *
+ * pool_parallelFor splits one job's work across the pool. the calling
+ * thread takes part, so it can be used from inside a job without waiting
+ * on workers that are busy with something else.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+
+typedef void (*pool_fn)(void *arg);
+typedef void (*pool_task)(void *ctx, int index);
+
+typedef struct pool_job {
+    pool_fn fn;
+    void *arg;
+    struct pool_job *next;
+} pool_job;
+
+typedef struct {
+    pthread_t *threads;
+    int threadCount;
+    pool_job *head, *tail;
+    int pending;            // queued + running jobs
+    int quit;
+    pthread_mutex_t lock;
+    pthread_cond_t work;    // signalled when a job is queued or on quit
+    pthread_cond_t idle;    // signalled when pending drops to zero
+} pool;
+
+int  pool_create(pool *p, int threads);
+int  pool_cpuCount(void);
+void pool_submit(pool *p, pool_fn fn, void *arg);
+void pool_wait(pool *p);
+void pool_parallelFor(pool *p, pool_task fn, void *ctx, int count);
+void pool_destroy(pool *p);
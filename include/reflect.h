@@ -0,0 +1,77 @@
+#pragma once
+
+/*
+ * reflect.h
+ * define a reflection type: a program's active uniforms, attributes and
+ * blocks, queried once after link through the program interface api.
+ *
+ * uniforms are addressed by the hash of their name (reflect_id), which can
+ * be computed once at startup and stays valid when the program is rebuilt.
+ * the setters remember the last value uploaded and skip the gl call when
+ * it hasn't changed.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include <glad/glad.h>
+#include <cglm/mat4.h>
+
+#include <shader.h>
+
+typedef struct {
+    uniform id;
+    GLint location;
+    GLenum type;
+    GLint size;
+    int valid;                  // value holds what the program has
+    unsigned char value[64];    // big enough for a mat4
+} reflectuniform;
+
+typedef struct {
+    uniform id;
+    char *name;
+    GLint location;
+    GLenum type;
+} reflectattribute;
+
+typedef struct {
+    uniform id;
+    char *name;
+    GLenum interface;           // GL_UNIFORM_BLOCK or GL_SHADER_STORAGE_BLOCK
+    GLuint index;
+    GLint binding;
+    GLint size;
+} reflectblock;
+
+typedef struct {
+    program prog;
+    reflectuniform *uniforms;
+    int uniformCount;
+    int *slots;                 // open addressing over uniforms, -1 is empty
+    int slotMask;
+    reflectattribute *attributes;
+    int attributeCount;
+    reflectblock *blocks;
+    int blockCount;
+    unsigned long uploads;      // glProgramUniform calls made
+    unsigned long skipped;      // setter calls elided as redundant
+} reflection;
+
+uniform reflect_id(const char *name);
+
+int  reflect_create(reflection *r, program prog);
+void reflect_destroy(reflection *r);
+
+reflectuniform   *reflect_uniform(reflection *r, uniform id);
+reflectattribute *reflect_attribute(reflection *r, const char *name);
+reflectblock     *reflect_block(reflection *r, const char *name);
+
+void reflect_setInt(reflection *r, uniform id, int value);
+void reflect_setUint(reflection *r, uniform id, unsigned int value);
+void reflect_setFloat(reflection *r, uniform id, float value);
+void reflect_setVec2(reflection *r, uniform id, vec2 value);
+void reflect_setVec3(reflection *r, uniform id, vec3 value);
+void reflect_setVec4(reflection *r, uniform id, vec4 value);
+void reflect_setMat4(reflection *r, uniform id, mat4 value);
@@ -0,0 +1,61 @@
+#pragma once
+
+/*
+ * scene.h
+ * define a scene type: object transforms and bounds kept in a bounding
+ * volume hierarchy, for frustum culling and ray picking in O(log n).
+ *
+ * the tree is built with the surface area heuristic over binned centroids.
+ * moving an object only refits the boxes on its path to the root, which
+ * keeps the tree valid but slowly less tight; rebuild after large changes.
+ * the depth is capped so traversal fits a fixed stack: past the cap a node
+ * stays a leaf however many objects it holds.
+ * objects are stored in leaf order, so a leaf's world boxes are one slice
+ * of a cullbounds and are tested together with cull_frustumRange.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include <cglm/mat4.h>
+
+#include "camera.h"
+#include "cull.h"
+
+#define SCENE_LEAF_SIZE 8       // one avx test per leaf
+#define SCENE_BINS      16
+
+typedef struct {
+    float min[3];
+    int first;                  // leaf: first slot, inner: left child (right is left + 1)
+    float max[3];
+    int count;                  // leaf: object count, inner: 0
+} bvhnode;
+
+typedef struct {
+    mat4 *transforms;
+    float (*localBounds)[6];    // min xyz, max xyz
+    float (*worldBounds)[6];
+    int len;
+    int cap;
+
+    bvhnode *nodes;
+    int *parents;
+    unsigned char *dirty;       // nodes waiting for a refit
+    int nodeCount;
+    uint32_t *order;            // slot -> object
+    int *slots;                 // object -> slot
+    int *leaves;                // object -> leaf node
+    cullbounds bounds;          // world boxes by slot
+    int built;
+} scene;
+
+int  scene_create(scene *s, int capacity);
+int  scene_add(scene *s, mat4 transform, const float localMin[3], const float localMax[3]);
+void scene_setTransform(scene *s, int object, mat4 transform);
+int  scene_build(scene *s);
+int  scene_refit(scene *s);
+int  scene_cull(scene *s, const frustum *f, uint32_t *visible);
+int  scene_pick(scene *s, const float origin[3], const float dir[3], float *distance);
+void scene_destroy(scene *s);
@@ -4,18 +4,135 @@
  * shader.h
  * define a shader type and functions to load shaders.
  * define a program type and functions to operate on it.
+ *
+ * shader_loadProgram builds a program from (path, type) pairs through an
+ * on-disk cache of program binaries, keyed by a hash of the sources and the
+ * driver's vendor, renderer and version. a missing or rejected binary falls
+ * back to compiling from source and refreshes the cache.
+ *
+ * a shaderbatch issues the compiles and links of many programs up front and
+ * is polled each frame; with GL_KHR_parallel_shader_compile they build on
+ * the driver's threads and shader_batchPoll never stalls. each program is
+ * written to its target and reported through the callback once it's done.
+ *
+ * a shaderreloader tracks the source files of its programs and rebuilds
+ * them in the background when one is saved. the new program replaces the
+ * old one only if it links; on failure the old one keeps drawing. if files
+ * can't be watched, shader_reloaderCreate returns 0 and the reloader still
+ * builds programs, it just never rebuilds them.
+ *
+ * sources are preprocessed before compiling: #include "file" pastes in a
+ * file relative to the includer, and a define set such as
+ * "INSTANCED ALPHA_TEST=1" is injected after #version. shadervariants
+ * caches one program per define set for a fixed list of stages.
  */
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdint.h>
 
 #include <glad/glad.h>
+#include <cglm/mat4.h>
+
+#include <watch.h>
 
 typedef unsigned int shader;
 typedef unsigned int program;
 typedef unsigned int uniform;
 
+#define SHADER_MAX_STAGES  6
+#define SHADER_CACHE_DIR   ".shadercache"
+#define SHADER_CACHE_MAGIC 0x48435350  // "PSCH"
+
+// per-frame uniform block (std140), bound to every program on link
+#define SHADER_FRAMEDATA_BLOCK   "FrameData"
+#define SHADER_FRAMEDATA_BINDING 0
+
+typedef struct {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 viewport;
+    float time;
+    float pad[3];
+} framedata;
+
+typedef void (*shader_callback)(program prog, int status, void *user);
+
+typedef struct {
+    program *target;
+    shader_callback callback;
+    void *user;
+    uint64_t key;           // binary cache key, 0 when not caching
+    int len;
+    shader shaders[SHADER_MAX_STAGES];
+    program prog;
+} shaderjob;
+
+typedef struct {
+    shaderjob *jobs;
+    int len;
+    int cap;
+    int parallel;
+} shaderbatch;
+
+typedef struct {
+    program *target;
+    program built;
+    shader_callback callback;   // runs after every successful (re)build
+    void *user;
+    char *defines;
+    int len;
+    char *paths[SHADER_MAX_STAGES];
+    GLenum types[SHADER_MAX_STAGES];
+    int *files;                 // watched stages and includes
+    int fileCount;
+    int fileCap;
+    int dirty;
+    int pending;
+} shaderprogram;
+
+typedef struct {
+    watcher watch;
+    shaderbatch batch;
+    shaderprogram **programs;
+    int len;
+    int cap;
+} shaderreloader;
+
+typedef struct {
+    uint64_t key;               // hash of the sorted define set
+    program prog;
+} shadervariant;
+
+// with a reloader, variants are rebuilt on edit; destroy it first
+typedef struct {
+    shaderreloader *reloader;
+    int len;
+    char *paths[SHADER_MAX_STAGES];
+    GLenum types[SHADER_MAX_STAGES];
+    shadervariant **variants;
+    int count;
+    int cap;
+} shadervariants;
+
 int shader_load(const char *source, GLenum type, shader *shd);
 int shader_loadFile(const char *path, GLenum type, shader *shd);
 int shader_createProgram(program *prog, int len, ...);
+int shader_loadProgram(program *prog, int len, ...);
+
+void shader_batchCreate(shaderbatch *batch);
+int shader_batchAdd(shaderbatch *batch, program *prog, shader_callback callback, void *user, int len, ...);
+int shader_batchPoll(shaderbatch *batch);
+void shader_batchWait(shaderbatch *batch);
+void shader_batchDestroy(shaderbatch *batch);
+
+int shader_reloaderCreate(shaderreloader *r);
+int shader_reloaderAdd(shaderreloader *r, program *prog, shader_callback callback, void *user, int len, ...);
+void shader_reloaderUpdate(shaderreloader *r);
+void shader_reloaderDestroy(shaderreloader *r);
+
+int shader_variantsCreate(shadervariants *v, shaderreloader *reloader, int len, ...);
+int shader_variant(shadervariants *v, const char *defines, program *prog);
+void shader_variantsDestroy(shadervariants *v);
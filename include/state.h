@@ -0,0 +1,48 @@
+#pragma once
+
+/*
+ * state.h
+ * define a render state tracker: a shadow copy of the gl state the renderer
+ * changes, so that setting something to the value it already has costs a
+ * compare instead of a driver call.
+ *
+ * every change of the tracked state has to go through it, anything that
+ * changes it behind its back must call state_invalidate. textures are
+ * bound per unit with glBindTextureUnit, the active unit is never touched.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <glad/glad.h>
+
+#define STATE_TEXTURE_UNITS 16
+
+typedef struct {
+    GLuint prog;
+    GLuint vao;
+    GLuint textures[STATE_TEXTURE_UNITS];
+    int blend;
+    GLenum blendSrc, blendDst;
+    int depthTest;
+    int depthWrite;
+    GLenum depthFunc;
+    int cullFace;
+    GLint viewport[4];
+    unsigned long calls;        // gl calls made
+    unsigned long elided;       // calls dropped as redundant
+} glstate;
+
+void state_create(glstate *s);
+void state_invalidate(glstate *s);
+
+void state_useProgram(glstate *s, GLuint prog);
+void state_bindVertexArray(glstate *s, GLuint vao);
+void state_bindTexture(glstate *s, int unit, GLuint texture);
+void state_blend(glstate *s, int enable);
+void state_blendFunc(glstate *s, GLenum src, GLenum dst);
+void state_depthTest(glstate *s, int enable);
+void state_depthWrite(glstate *s, int enable);
+void state_depthFunc(glstate *s, GLenum func);
+void state_cullFace(glstate *s, int enable);
+void state_viewport(glstate *s, GLint x, GLint y, GLint w, GLint h);
@@ -0,0 +1,30 @@
+#pragma once
+
+/*
+ * stream.h
+ * define a stream type: a persistently mapped ring buffer for per-frame data.
+ * the buffer is split into one region per frame in flight, each guarded by a
+ * fence so the cpu never writes memory the gpu is still reading.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <glad/glad.h>
+
+#define STREAM_FRAMES 3
+
+typedef struct {
+    unsigned int buffer;
+    unsigned char *mapped;
+    GLsizeiptr regionSize;
+    GLintptr head;
+    int frame;
+    GLsync fences[STREAM_FRAMES];
+} stream;
+
+int   stream_create(stream *strm, GLenum target, GLsizeiptr frameSize);
+void  stream_begin(stream *strm);
+void *stream_alloc(stream *strm, GLsizeiptr size, GLsizeiptr align, GLintptr *offset);
+void  stream_end(stream *strm);
+void  stream_destroy(stream *strm);
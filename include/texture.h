@@ -0,0 +1,82 @@
+#pragma once
+
+/*
+ * texture.h
+ * define a texture type and an asynchronous loader for it.
+ * files are mapped rather than read. a worker reads the image size from the
+ * mapping, the render thread maps a pixel unpack buffer of that size, and a
+ * worker then decodes with stb_image straight into it (see imagealloc.h), so
+ * the upload is a single copy on the gpu side. until that happens the
+ * texture holds a small placeholder, so it can be bound at once. large
+ * images are also split across the pool while they decode.
+ *
+ * images decode to the layout the texture stores (r8, rg8 or rgba8, rgb is
+ * padded by stb_image), so the driver converts nothing on the way. grey
+ * textures are swizzled back to grey when sampled.
+ *
+ * .dds files hold a pre-built, block-compressed mip chain (see tools/texconv):
+ * they are only mapped on the worker and uploaded level by level as is.
+ *
+ * textures get immutable storage with a full mip chain once their size is
+ * known. the chain is built on the workers right after decoding (see mip.h)
+ * and uploaded with the image from one buffer. srgb marks colour images,
+ * whose mips are filtered in linear light; leave it off for data such as
+ * masks or height maps.
+ *
+ * with ARB_bindless_texture, every texture also gets a resident handle in a
+ * storage buffer at TEXTURE_HANDLE_BINDING, indexed by its slot, so shaders
+ * pick textures without any binding changes. without it, callers bind
+ * tex->id as usual.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdatomic.h>
+
+#include <glad/glad.h>
+
+#include "dds.h"
+#include "pool.h"
+
+#define TEXTURE_HANDLE_BINDING 1
+
+enum {
+    TEXTURE_PENDING,    // queued or decoding on a worker
+    TEXTURE_SIZED,      // size known, waiting for a staging buffer
+    TEXTURE_DECODED,    // pixels ready, waiting for the render thread
+    TEXTURE_READY,      // uploaded
+    TEXTURE_FAILED      // decode failed, placeholder stays
+};
+
+typedef struct {
+    unsigned int id;        // the loader's placeholder until uploaded
+    int slot;               // index into the handle buffer
+    char *path;
+    int width, height, channels;   // channels as uploaded: 1, 2 or 4
+    unsigned char *file;    // the mapped file until it's decoded or uploaded
+    size_t fileSize;
+    unsigned int pbo;       // pixel unpack buffer the image decodes into
+    void *staging;          // its mapping, written by a worker
+    pool *workers;          // the loader's, decodes and mips are split across it
+    int compressed;
+    int srgb;               // colour data: mips are filtered in linear light
+    ddsinfo dds;
+    atomic_int state;
+} texture;
+
+typedef struct {
+    pool workers;
+    texture **textures;
+    int len, cap;
+    unsigned int placeholder;
+    int bindless;
+    GLuint64 *handles;      // cpu mirror of the handle buffer
+    GLuint64 placeholderHandle;
+    unsigned int handleBuffer;
+    int handleCap;
+} texloader;
+
+int      texture_loaderCreate(texloader *l, int threads);
+texture *texture_load(texloader *l, const char *path, int srgb);
+int      texture_update(texloader *l);
+void     texture_loaderDestroy(texloader *l);
@@ -0,0 +1,43 @@
+#pragma once
+
+/*
+ * vertex.h
+ * define a vertex format type describing how each attribute is stored on
+ * the gpu, and functions to pack float vertices into it and bind it.
+ *
+ * source vertices are floats: position (3), texcoord (2), then normal (3)
+ * when the format has one. vertex_srcStride is the floats a format needs.
+ *
+ * shaders still see vec3/vec2 inputs, the normalized integer and half types
+ * are expanded by the vertex fetch. octahedral normals are the exception:
+ * they arrive as a vec2 and the shader decodes them (see vertex.glsl).
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+
+#include <glad/glad.h>
+
+// attribute locations, 2-5 are taken by the per-instance model matrix
+#define VERTEX_ATTR_POSITION 0
+#define VERTEX_ATTR_TEXCOORD 1
+#define VERTEX_ATTR_NORMAL   6
+
+typedef struct {
+    GLenum position;    // GL_FLOAT, GL_HALF_FLOAT or GL_SHORT (snorm16, dequantised per mesh)
+    GLenum texcoord;    // GL_FLOAT, GL_HALF_FLOAT or GL_UNSIGNED_SHORT (unorm16)
+    GLenum normal;      // GL_NONE, GL_FLOAT or GL_SHORT (octahedral snorm16x2)
+} vertexformat;
+
+#define VERTEXFORMAT_FLOAT   ((vertexformat) { GL_FLOAT, GL_FLOAT, GL_NONE })
+#define VERTEXFORMAT_COMPACT ((vertexformat) { GL_SHORT, GL_UNSIGNED_SHORT, GL_NONE })
+
+int      vertex_srcStride(const vertexformat *fmt);
+int      vertex_stride(const vertexformat *fmt);
+void     vertex_pack(vertexformat *fmt, const float *src, int count, int srcStride, void *dst, float scale[3], float offset[3]);
+void     vertex_bind(const vertexformat *fmt);
+void     vertex_position(const vertexformat *fmt, const void *vertex, float out[3]);
+uint16_t vertex_toHalf(float f);
+float    vertex_fromHalf(uint16_t h);
+void     vertex_octEncode(const float n[3], int16_t out[2]);
@@ -0,0 +1,32 @@
+#pragma once
+
+/*
+ * watch.h
+ * define a file watcher type: reports edits to a set of files through
+ * inotify, polled from the render loop without blocking.
+ *
+ * the containing directory is watched rather than the file itself so that
+ * editors which save by writing a temp file and renaming it are still seen.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+typedef void (*watch_fn)(int file, void *user);
+
+typedef struct {
+    int wd;                 // inotify watch on the file's directory
+    char *name;             // file name within that directory
+} watchfile;
+
+typedef struct {
+    int fd;
+    watchfile *files;
+    int len;
+    int cap;
+} watcher;
+
+int  watch_create(watcher *w);
+int  watch_add(watcher *w, const char *path);
+int  watch_poll(watcher *w, watch_fn fn, void *user);
+void watch_destroy(watcher *w);
@@ -514,6 +514,23 @@ STBIDEF void stbi_convert_iphone_png_to_rgb(int flag_true_if_should_convert);
 // flip the image vertically, so the first pixel in the output array is the bottom left
 STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip);
 
+// cap the SIMD level used by the JPEG kernels: 0 = scalar, 1 = SSE2/NEON,
+// 2 = AVX2, 3 = AVX-512. defaults to the best the CPU supports; mainly
+// useful for benchmarking and for checking the SIMD paths against scalar.
+STBIDEF void stbi_set_jpeg_simd_level(int level);
+
+// decode single large images on several threads. fn must call task(ctx, i)
+// for every i in [0, count), on whatever threads it likes, and return once
+// all of them are done. only images of at least STBI_PARALLEL_MIN_PIXELS
+// are split. NULL (the default) decodes serially; the pixels are the same
+// either way. jpeg: restart intervals are entropy-decoded in parallel when
+// decoding from memory, progressive IDCT and the upsampling/color conversion
+// are split by rows. png: unfiltering is split at rows that don't depend on
+// the row above; inflate stays serial.
+typedef void (*stbi_parallel_task)(void *ctx, int index);
+typedef void (*stbi_parallel_for)(stbi_parallel_task task, void *ctx, int count, void *user);
+STBIDEF void stbi_set_parallel_for(stbi_parallel_for fn, void *user);
+
 // as above, but only applies to images loaded on the thread that calls the function
 // this function is only available if your compiler supports thread-local variables;
 // calling it will fail to link if your compiler doesn't
@@ -771,6 +788,27 @@ static int stbi__sse2_available(void)
 #endif
 #endif
 
+// AVX2 / AVX-512BW JPEG kernels. these are compiled per function with target
+// attributes and chosen at runtime, so the rest of the file still only
+// assumes SSE2. GCC/Clang only; define STBI_NO_AVX2 to leave them out.
+#if defined(STBI_SSE2) && !defined(STBI_NO_AVX2) && !defined(STBI_NO_JPEG) && defined(__GNUC__)
+#define STBI_AVX2
+#include <immintrin.h>
+
+#define STBI__TARGET_AVX2    __attribute__((target("avx2")))
+#define STBI__TARGET_AVX512  __attribute__((target("avx2,avx512f,avx512bw")))
+
+static int stbi__avx2_available(void)
+{
+   return __builtin_cpu_supports("avx2");
+}
+
+static int stbi__avx512_available(void)
+{
+   return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+}
+#endif
+
 // ARM NEON
 #if defined(STBI_NO_SIMD) && defined(STBI_NEON)
 #undef STBI_NEON
@@ -1098,6 +1136,51 @@ STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip)
    stbi__vertically_flip_on_load_global = flag_true_if_should_flip;
 }
 
+static int stbi__jpeg_simd_level = 3;
+
+STBIDEF void stbi_set_jpeg_simd_level(int level)
+{
+   stbi__jpeg_simd_level = level;
+}
+
+#ifndef STBI_PARALLEL_MIN_PIXELS
+#define STBI_PARALLEL_MIN_PIXELS  (1 << 20)
+#endif
+
+// upper bound on the tasks one image is split into
+#ifndef STBI_PARALLEL_TASKS
+#define STBI_PARALLEL_TASKS  32
+#endif
+
+static stbi_parallel_for stbi__parallel_fn = NULL;
+static void *stbi__parallel_user = NULL;
+
+STBIDEF void stbi_set_parallel_for(stbi_parallel_for fn, void *user)
+{
+   stbi__parallel_fn = fn;
+   stbi__parallel_user = user;
+}
+
+#if !defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG)
+// how many tasks to split n units of work of an x*y image into; 1 = serial
+static int stbi__parallel_tasks(stbi__uint32 x, stbi__uint32 y, int n)
+{
+   if (!stbi__parallel_fn || (double) x * y < STBI_PARALLEL_MIN_PIXELS) return 1;
+   return n < STBI_PARALLEL_TASKS ? (n > 1 ? n : 1) : STBI_PARALLEL_TASKS;
+}
+
+static void stbi__parallel(stbi_parallel_task task, void *ctx, int count)
+{
+   int i;
+   if (count > 1 && stbi__parallel_fn) {
+      stbi__parallel_fn(task, ctx, count, stbi__parallel_user);
+      return;
+   }
+   for (i=0; i < count; ++i)
+      task(ctx, i);
+}
+#endif
+
 #ifndef STBI_THREAD_LOCAL
 #define stbi__vertically_flip_on_load  stbi__vertically_flip_on_load_global
 #else
@@ -2670,6 +2753,169 @@ static void stbi__idct_simd(stbi_uc *out, int out_stride, short data[64])
 
 #endif // STBI_SSE2
 
+#ifdef STBI_AVX2
+// avx2 version of the sse2 IDCT above. rows and transposes stay 16-bit, but
+// each 32-bit stage covers a whole row in one register instead of a lo/hi
+// pair, which halves the multiply-add and butterfly work. produces the same
+// output as stbi__idct_simd.
+static STBI__TARGET_AVX2 void stbi__idct_avx2(stbi_uc *out, int out_stride, short data[64])
+{
+   __m128i row0, row1, row2, row3, row4, row5, row6, row7;
+   __m128i tmp;
+
+   // dot product constant: even elems=x, odd elems=y
+   #define dct_const(x,y)  _mm256_setr_epi16((x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y))
+
+   // out0 = c0[even]*x + c0[odd]*y, out1 likewise with c1 (x, y 16-bit, out 32-bit)
+   #define dct_rot(out0,out1, x,y,c0,c1) \
+      __m256i c0##xy = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi16((x),(y))), \
+                                              _mm_unpackhi_epi16((x),(y)), 1); \
+      __m256i out0 = _mm256_madd_epi16(c0##xy, c0); \
+      __m256i out1 = _mm256_madd_epi16(c0##xy, c1)
+
+   // out = in << 12  (in 16-bit, out 32-bit)
+   #define dct_widen(out, in) \
+      __m256i out = _mm256_slli_epi32(_mm256_cvtepi16_epi32(in), 12)
+
+   // butterfly a/b, add bias, then shift by "s" and pack
+   #define dct_bfly32o(out0, out1, a,b,bias,s) \
+      { \
+         __m256i abiased = _mm256_add_epi32(a, bias); \
+         __m256i sum = _mm256_srai_epi32(_mm256_add_epi32(abiased, b), s); \
+         __m256i dif = _mm256_srai_epi32(_mm256_sub_epi32(abiased, b), s); \
+         out0 = _mm_packs_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1)); \
+         out1 = _mm_packs_epi32(_mm256_castsi256_si128(dif), _mm256_extracti128_si256(dif, 1)); \
+      }
+
+   // 8-bit interleave step (for transposes)
+   #define dct_interleave8(a, b) \
+      tmp = a; \
+      a = _mm_unpacklo_epi8(a, b); \
+      b = _mm_unpackhi_epi8(tmp, b)
+
+   // 16-bit interleave step (for transposes)
+   #define dct_interleave16(a, b) \
+      tmp = a; \
+      a = _mm_unpacklo_epi16(a, b); \
+      b = _mm_unpackhi_epi16(tmp, b)
+
+   #define dct_pass(bias,shift) \
+      { \
+         /* even part */ \
+         dct_rot(t2e,t3e, row2,row6, rot0_0,rot0_1); \
+         __m128i sum04 = _mm_add_epi16(row0, row4); \
+         __m128i dif04 = _mm_sub_epi16(row0, row4); \
+         dct_widen(t0e, sum04); \
+         dct_widen(t1e, dif04); \
+         __m256i x0 = _mm256_add_epi32(t0e, t3e); \
+         __m256i x3 = _mm256_sub_epi32(t0e, t3e); \
+         __m256i x1 = _mm256_add_epi32(t1e, t2e); \
+         __m256i x2 = _mm256_sub_epi32(t1e, t2e); \
+         /* odd part */ \
+         dct_rot(y0o,y2o, row7,row3, rot2_0,rot2_1); \
+         dct_rot(y1o,y3o, row5,row1, rot3_0,rot3_1); \
+         __m128i sum17 = _mm_add_epi16(row1, row7); \
+         __m128i sum35 = _mm_add_epi16(row3, row5); \
+         dct_rot(y4o,y5o, sum17,sum35, rot1_0,rot1_1); \
+         __m256i x4 = _mm256_add_epi32(y0o, y4o); \
+         __m256i x5 = _mm256_add_epi32(y1o, y5o); \
+         __m256i x6 = _mm256_add_epi32(y2o, y5o); \
+         __m256i x7 = _mm256_add_epi32(y3o, y4o); \
+         dct_bfly32o(row0,row7, x0,x7,bias,shift); \
+         dct_bfly32o(row1,row6, x1,x6,bias,shift); \
+         dct_bfly32o(row2,row5, x2,x5,bias,shift); \
+         dct_bfly32o(row3,row4, x3,x4,bias,shift); \
+      }
+
+   __m256i rot0_0 = dct_const(stbi__f2f(0.5411961f), stbi__f2f(0.5411961f) + stbi__f2f(-1.847759065f));
+   __m256i rot0_1 = dct_const(stbi__f2f(0.5411961f) + stbi__f2f( 0.765366865f), stbi__f2f(0.5411961f));
+   __m256i rot1_0 = dct_const(stbi__f2f(1.175875602f) + stbi__f2f(-0.899976223f), stbi__f2f(1.175875602f));
+   __m256i rot1_1 = dct_const(stbi__f2f(1.175875602f), stbi__f2f(1.175875602f) + stbi__f2f(-2.562915447f));
+   __m256i rot2_0 = dct_const(stbi__f2f(-1.961570560f) + stbi__f2f( 0.298631336f), stbi__f2f(-1.961570560f));
+   __m256i rot2_1 = dct_const(stbi__f2f(-1.961570560f), stbi__f2f(-1.961570560f) + stbi__f2f( 3.072711026f));
+   __m256i rot3_0 = dct_const(stbi__f2f(-0.390180644f) + stbi__f2f( 2.053119869f), stbi__f2f(-0.390180644f));
+   __m256i rot3_1 = dct_const(stbi__f2f(-0.390180644f), stbi__f2f(-0.390180644f) + stbi__f2f( 1.501321110f));
+
+   // rounding biases in column/row passes, see stbi__idct_block for explanation.
+   __m256i bias_0 = _mm256_set1_epi32(512);
+   __m256i bias_1 = _mm256_set1_epi32(65536 + (128<<17));
+
+   // load
+   row0 = _mm_load_si128((const __m128i *) (data + 0*8));
+   row1 = _mm_load_si128((const __m128i *) (data + 1*8));
+   row2 = _mm_load_si128((const __m128i *) (data + 2*8));
+   row3 = _mm_load_si128((const __m128i *) (data + 3*8));
+   row4 = _mm_load_si128((const __m128i *) (data + 4*8));
+   row5 = _mm_load_si128((const __m128i *) (data + 5*8));
+   row6 = _mm_load_si128((const __m128i *) (data + 6*8));
+   row7 = _mm_load_si128((const __m128i *) (data + 7*8));
+
+   // column pass
+   dct_pass(bias_0, 10);
+
+   {
+      // 16bit 8x8 transpose pass 1
+      dct_interleave16(row0, row4);
+      dct_interleave16(row1, row5);
+      dct_interleave16(row2, row6);
+      dct_interleave16(row3, row7);
+
+      // transpose pass 2
+      dct_interleave16(row0, row2);
+      dct_interleave16(row1, row3);
+      dct_interleave16(row4, row6);
+      dct_interleave16(row5, row7);
+
+      // transpose pass 3
+      dct_interleave16(row0, row1);
+      dct_interleave16(row2, row3);
+      dct_interleave16(row4, row5);
+      dct_interleave16(row6, row7);
+   }
+
+   // row pass
+   dct_pass(bias_1, 17);
+
+   {
+      // pack
+      __m128i p0 = _mm_packus_epi16(row0, row1); // a0a1a2a3...a7b0b1b2b3...b7
+      __m128i p1 = _mm_packus_epi16(row2, row3);
+      __m128i p2 = _mm_packus_epi16(row4, row5);
+      __m128i p3 = _mm_packus_epi16(row6, row7);
+
+      // 8bit 8x8 transpose pass 1
+      dct_interleave8(p0, p2); // a0e0a1e1...
+      dct_interleave8(p1, p3); // c0g0c1g1...
+
+      // transpose pass 2
+      dct_interleave8(p0, p1); // a0c0e0g0...
+      dct_interleave8(p2, p3); // b0d0f0h0...
+
+      // transpose pass 3
+      dct_interleave8(p0, p2); // a0b0c0d0...
+      dct_interleave8(p1, p3); // a4b4c4d4...
+
+      // store
+      _mm_storel_epi64((__m128i *) out, p0); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p0, 0x4e)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, p2); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p2, 0x4e)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, p1); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p1, 0x4e)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, p3); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p3, 0x4e));
+   }
+
+#undef dct_const
+#undef dct_rot
+#undef dct_widen
+#undef dct_bfly32o
+#undef dct_interleave8
+#undef dct_interleave16
+#undef dct_pass
+}
+#endif // STBI_AVX2
+
 #ifdef STBI_NEON
 
 // NEON integer IDCT. should produce bit-identical
@@ -2912,8 +3158,169 @@ static void stbi__jpeg_reset(stbi__jpeg *j)
    // since we don't even allow 1<<30 pixels
 }
 
+// decode MCU m of the current scan, counting in scan order. same work as one
+// step of the loops in stbi__parse_entropy_coded_data, minus the restart
+// handling.
+static int stbi__jpeg_decode_mcu(stbi__jpeg *z, int m)
+{
+   int i,j,k,n,x,y;
+   STBI_SIMD_ALIGN(short, data[64]);
+
+   if (z->scan_n == 1) {
+      // non-interleaved: every block is an MCU
+      n = z->order[0];
+      i = m % ((z->img_comp[n].x+7) >> 3);
+      j = m / ((z->img_comp[n].x+7) >> 3);
+      if (!z->progressive) {
+         int ha = z->img_comp[n].ha;
+         if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+         z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+      } else {
+         short *coeff = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
+         if (z->spec_start == 0) {
+            if (!stbi__jpeg_decode_block_prog_dc(z, coeff, &z->huff_dc[z->img_comp[n].hd], n))
+               return 0;
+         } else {
+            int ha = z->img_comp[n].ha;
+            if (!stbi__jpeg_decode_block_prog_ac(z, coeff, &z->huff_ac[ha], z->fast_ac[ha]))
+               return 0;
+         }
+      }
+      return 1;
+   }
+
+   i = m % z->img_mcu_x;
+   j = m / z->img_mcu_x;
+   for (k=0; k < z->scan_n; ++k) {
+      n = z->order[k];
+      for (y=0; y < z->img_comp[n].v; ++y) {
+         for (x=0; x < z->img_comp[n].h; ++x) {
+            int x2 = i*z->img_comp[n].h + x;
+            int y2 = j*z->img_comp[n].v + y;
+            if (!z->progressive) {
+               int ha = z->img_comp[n].ha;
+               if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*y2*8+x2*8, z->img_comp[n].w2, data);
+            } else {
+               short *coeff = z->img_comp[n].coeff + 64 * (x2 + y2 * z->img_comp[n].coeff_w);
+               if (!stbi__jpeg_decode_block_prog_dc(z, coeff, &z->huff_dc[z->img_comp[n].hd], n))
+                  return 0;
+            }
+         }
+      }
+   }
+   return 1;
+}
+
+typedef struct
+{
+   stbi__jpeg *z;
+   stbi_uc **start, **end; // entropy-coded bytes of each restart interval
+   int intervals, mcus, tasks;
+   stbi_uc failed[STBI_PARALLEL_TASKS]; // per task, so no task reads another's
+} stbi__jpeg_restarts;
+
+// decode a contiguous run of restart intervals with a private copy of the
+// decoder state, reading each interval as its own memory stream
+static void stbi__jpeg_decode_intervals(void *ctx, int index)
+{
+   stbi__jpeg_restarts *r = (stbi__jpeg_restarts *) ctx;
+   int first = r->intervals * index / r->tasks;
+   int last  = r->intervals * (index+1) / r->tasks;
+   int i,m;
+   stbi__context s = *r->z->s;
+   stbi__jpeg *j = (stbi__jpeg *) stbi__malloc(sizeof(stbi__jpeg));
+   if (!j) { r->failed[index] = 1; return; }
+
+   *j = *r->z;
+   j->s = &s;
+   s.io.read = NULL;
+   s.read_from_callbacks = 0;
+
+   for (i=first; i < last && !r->failed[index]; ++i) {
+      int end = (i+1) * r->z->restart_interval;
+      if (end > r->mcus) end = r->mcus;
+      s.img_buffer = r->start[i];
+      s.img_buffer_end = r->end[i];
+      stbi__jpeg_reset(j);
+      for (m=i * r->z->restart_interval; m < end; ++m) {
+         if (!stbi__jpeg_decode_mcu(j, m)) { r->failed[index] = 1; break; }
+      }
+   }
+
+   STBI_FREE(j);
+}
+
+// split the scan at its RSTn markers. returns the number of intervals found
+// and leaves *next at the marker that ends the scan.
+static int stbi__jpeg_find_restarts(stbi_uc *p, stbi_uc *end, stbi_uc **start, stbi_uc **stop, int count, stbi_uc **next)
+{
+   int n = 0;
+   start[0] = p;
+   while (p+1 < end) {
+      p = (stbi_uc *) memchr(p, 0xff, end-1 - p);
+      if (!p) break;
+      if (p[1] == 0x00) { p += 2; continue; } // stuffed byte
+      if (p[1] == 0xff) { p += 1; continue; } // fill byte
+      if (n == count) return n+1;              // too many intervals
+      stop[n++] = p;
+      if (!STBI__RESTART(p[1])) { *next = p; return n; }
+      p += 2;
+      if (n < count) start[n] = p;
+   }
+   return -1;
+}
+
+// decode the scan's restart intervals in parallel. returns -1 when that
+// isn't possible and the caller should decode serially.
+static int stbi__jpeg_parse_parallel(stbi__jpeg *z)
+{
+   stbi__jpeg_restarts r;
+   stbi_uc *next = NULL;
+   int found, i, failed = 0;
+
+   if (!z->restart_interval || z->s->io.read) return -1;
+
+   if (z->scan_n == 1) {
+      int n = z->order[0];
+      r.mcus = ((z->img_comp[n].x+7) >> 3) * ((z->img_comp[n].y+7) >> 3);
+   } else {
+      r.mcus = z->img_mcu_x * z->img_mcu_y;
+   }
+   r.intervals = (r.mcus + z->restart_interval-1) / z->restart_interval;
+   r.tasks = stbi__parallel_tasks(z->s->img_x, z->s->img_y, r.intervals);
+   if (r.tasks < 2) return -1;
+
+   r.start = (stbi_uc **) stbi__malloc_mad2(r.intervals, 2 * sizeof(stbi_uc *), 0);
+   if (!r.start) return -1;
+   r.end = r.start + r.intervals;
+
+   // the serial path copes with missing or extra markers, leave those to it
+   found = stbi__jpeg_find_restarts(z->s->img_buffer, z->s->img_buffer_end, r.start, r.end, r.intervals, &next);
+   if (found != r.intervals) {
+      STBI_FREE(r.start);
+      return -1;
+   }
+
+   r.z = z;
+   memset(r.failed, 0, sizeof(r.failed));
+   stbi__parallel(stbi__jpeg_decode_intervals, &r, r.tasks);
+   STBI_FREE(r.start);
+   for (i=0; i < r.tasks; ++i)
+      failed |= r.failed[i];
+   if (failed) return stbi__err("bad restart interval", "Corrupt JPEG");
+
+   // continue after the scan, like the serial decoder does
+   z->s->img_buffer = next;
+   z->marker = STBI__MARKER_none;
+   return 1;
+}
+
 static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
 {
+   int result = stbi__jpeg_parse_parallel(z);
+   if (result >= 0) return result;
+
    stbi__jpeg_reset(z);
    if (!z->progressive) {
       if (z->scan_n == 1) {
@@ -3043,21 +3450,39 @@ static void stbi__jpeg_dequantize(short *data, stbi__uint16 *dequant)
       data[i] *= dequant[i];
 }
 
+typedef struct
+{
+   stbi__jpeg *z;
+   int n, rows, tasks;
+} stbi__jpeg_blockrows;
+
+// dequantize and idct a band of block rows of component n
+static void stbi__jpeg_finish_rows(void *ctx, int index)
+{
+   stbi__jpeg_blockrows *b = (stbi__jpeg_blockrows *) ctx;
+   stbi__jpeg *z = b->z;
+   int n = b->n;
+   int w = (z->img_comp[n].x+7) >> 3;
+   int i,j;
+   for (j=b->rows * index / b->tasks; j < b->rows * (index+1) / b->tasks; ++j) {
+      for (i=0; i < w; ++i) {
+         short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
+         stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
+         z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+      }
+   }
+}
+
 static void stbi__jpeg_finish(stbi__jpeg *z)
 {
    if (z->progressive) {
       // dequantize and idct the data
-      int i,j,n;
-      for (n=0; n < z->s->img_n; ++n) {
-         int w = (z->img_comp[n].x+7) >> 3;
-         int h = (z->img_comp[n].y+7) >> 3;
-         for (j=0; j < h; ++j) {
-            for (i=0; i < w; ++i) {
-               short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
-               stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
-            }
-         }
+      stbi__jpeg_blockrows b;
+      b.z = z;
+      for (b.n=0; b.n < z->s->img_n; ++b.n) {
+         b.rows = (z->img_comp[b.n].y+7) >> 3;
+         b.tasks = stbi__parallel_tasks(z->s->img_x, z->s->img_y, b.rows);
+         stbi__parallel(stbi__jpeg_finish_rows, &b, b.tasks);
       }
    }
 }
@@ -3589,6 +4014,112 @@ static stbi_uc *stbi__resample_row_hv_2_simd(stbi_uc *out, stbi_uc *in_near, stb
 }
 #endif
 
+#ifdef STBI_AVX2
+// the wide versions build the previous/current/next columns of the vertical
+// pass from three shifted loads instead of carrying the previous pixel
+// between iterations, so the horizontal filter needs no cross-lane shifts.
+// pixel 0 and the last pixel have boundary conditions, so they and the
+// leftover pixels go through the scalar filter.
+static STBI__TARGET_AVX2 stbi_uc *stbi__resample_row_hv_2_avx2(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
+{
+   int i,t0,t1;
+
+   if (w == 1) {
+      out[0] = out[1] = stbi__div4(3*in_near[0] + in_far[0] + 2);
+      return out;
+   }
+
+   t1 = 3*in_near[0] + in_far[0];
+   out[0] = stbi__div4(t1+2);
+   out[1] = stbi__div16(3*t1 + 3*in_near[1] + in_far[1] + 8);
+
+   // groups of 16 pixels, as long as pixel i+16 is still inside the row
+   for (i=1; i+16 < w; i += 16) {
+      #define stbi__vert16(k) \
+         _mm256_add_epi16(_mm256_mullo_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (in_near + (k)))), three), \
+                          _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (in_far + (k)))))
+      __m256i three = _mm256_set1_epi16(3);
+      __m256i bias  = _mm256_set1_epi16(8);
+      __m256i prev  = stbi__vert16(i-1);
+      __m256i curr  = stbi__vert16(i);
+      __m256i next  = stbi__vert16(i+1);
+      #undef stbi__vert16
+
+      // even pixels = 3*cur + prev, odd pixels = 3*cur + next
+      __m256i curb = _mm256_add_epi16(_mm256_mullo_epi16(curr, three), bias);
+      __m256i even = _mm256_add_epi16(curb, prev);
+      __m256i odd  = _mm256_add_epi16(curb, next);
+
+      // interleave and undo scaling. unpack and pack both stay within 128-bit
+      // lanes, so lane 0 ends up with pixels 0..7 and lane 1 with 8..15.
+      __m256i int0 = _mm256_srli_epi16(_mm256_unpacklo_epi16(even, odd), 4);
+      __m256i int1 = _mm256_srli_epi16(_mm256_unpackhi_epi16(even, odd), 4);
+      _mm256_storeu_si256((__m256i *) (out + i*2), _mm256_packus_epi16(int0, int1));
+   }
+
+   t1 = 3*in_near[i-1] + in_far[i-1];
+   for (; i < w; ++i) {
+      t0 = t1;
+      t1 = 3*in_near[i]+in_far[i];
+      out[i*2-1] = stbi__div16(3*t0 + t1 + 8);
+      out[i*2  ] = stbi__div16(3*t1 + t0 + 8);
+   }
+   out[w*2-1] = stbi__div4(t1+2);
+
+   STBI_NOTUSED(hs);
+
+   return out;
+}
+
+static STBI__TARGET_AVX512 stbi_uc *stbi__resample_row_hv_2_avx512(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
+{
+   int i,t0,t1;
+
+   if (w == 1) {
+      out[0] = out[1] = stbi__div4(3*in_near[0] + in_far[0] + 2);
+      return out;
+   }
+
+   t1 = 3*in_near[0] + in_far[0];
+   out[0] = stbi__div4(t1+2);
+   out[1] = stbi__div16(3*t1 + 3*in_near[1] + in_far[1] + 8);
+
+   // same as the avx2 version with 32 pixels per iteration
+   for (i=1; i+32 < w; i += 32) {
+      #define stbi__vert32(k) \
+         _mm512_add_epi16(_mm512_mullo_epi16(_mm512_cvtepu8_epi16(_mm256_loadu_si256((__m256i *) (in_near + (k)))), three), \
+                          _mm512_cvtepu8_epi16(_mm256_loadu_si256((__m256i *) (in_far + (k)))))
+      __m512i three = _mm512_set1_epi16(3);
+      __m512i bias  = _mm512_set1_epi16(8);
+      __m512i prev  = stbi__vert32(i-1);
+      __m512i curr  = stbi__vert32(i);
+      __m512i next  = stbi__vert32(i+1);
+      #undef stbi__vert32
+
+      __m512i curb = _mm512_add_epi16(_mm512_mullo_epi16(curr, three), bias);
+      __m512i even = _mm512_add_epi16(curb, prev);
+      __m512i odd  = _mm512_add_epi16(curb, next);
+
+      __m512i int0 = _mm512_srli_epi16(_mm512_unpacklo_epi16(even, odd), 4);
+      __m512i int1 = _mm512_srli_epi16(_mm512_unpackhi_epi16(even, odd), 4);
+      _mm512_storeu_si512((void *) (out + i*2), _mm512_packus_epi16(int0, int1));
+   }
+
+   t1 = 3*in_near[i-1] + in_far[i-1];
+   for (; i < w; ++i) {
+      t0 = t1;
+      t1 = 3*in_near[i]+in_far[i];
+      out[i*2-1] = stbi__div16(3*t0 + t1 + 8);
+      out[i*2  ] = stbi__div16(3*t1 + t0 + 8);
+   }
+   out[w*2-1] = stbi__div4(t1+2);
+
+   STBI_NOTUSED(hs);
+
+   return out;
+}
+#endif
+
 static stbi_uc *stbi__resample_row_generic(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
 {
    // resample with nearest-neighbor
@@ -3763,6 +4294,121 @@ static void stbi__YCbCr_to_RGB_simd(stbi_uc *out, stbi_uc const *y, stbi_uc cons
 }
 #endif
 
+#ifdef STBI_AVX2
+// avx2/avx-512 versions of the sse2 color conversion, 16 or 32 pixels at a
+// time. the 16-bit math is the same, so output matches the scalar path; only
+// step == 4 is accelerated and the remainder goes through the scalar row.
+static STBI__TARGET_AVX2 void stbi__YCbCr_to_RGB_avx2(stbi_uc *out, stbi_uc const *y, stbi_uc const *pcb, stbi_uc const *pcr, int count, int step)
+{
+   int i = 0;
+
+   if (step == 4) {
+      __m256i cr_const0 = _mm256_set1_epi16(   (short) ( 1.40200f*4096.0f+0.5f));
+      __m256i cr_const1 = _mm256_set1_epi16( - (short) ( 0.71414f*4096.0f+0.5f));
+      __m256i cb_const0 = _mm256_set1_epi16( - (short) ( 0.34414f*4096.0f+0.5f));
+      __m256i cb_const1 = _mm256_set1_epi16(   (short) ( 1.77200f*4096.0f+0.5f));
+      __m256i bias = _mm256_set1_epi16(128);
+      __m256i xw = _mm256_set1_epi16(255); // alpha channel
+
+      for (; i+15 < count; i += 16) {
+         // widen to short: y as (y << 8) + 128, cr/cb as (c - 128) << 8
+         __m256i yb  = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (y+i)));
+         __m256i crb = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (pcr+i)));
+         __m256i cbb = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (pcb+i)));
+         __m256i yw  = _mm256_or_si256(_mm256_slli_epi16(yb, 8), bias);
+         __m256i crw = _mm256_slli_epi16(_mm256_sub_epi16(crb, bias), 8);
+         __m256i cbw = _mm256_slli_epi16(_mm256_sub_epi16(cbb, bias), 8);
+
+         // color transform
+         __m256i yws = _mm256_srli_epi16(yw, 4);
+         __m256i cr0 = _mm256_mulhi_epi16(cr_const0, crw);
+         __m256i cb0 = _mm256_mulhi_epi16(cb_const0, cbw);
+         __m256i cb1 = _mm256_mulhi_epi16(cbw, cb_const1);
+         __m256i cr1 = _mm256_mulhi_epi16(crw, cr_const1);
+         __m256i rws = _mm256_add_epi16(cr0, yws);
+         __m256i gwt = _mm256_add_epi16(cb0, yws);
+         __m256i bws = _mm256_add_epi16(yws, cb1);
+         __m256i gws = _mm256_add_epi16(gwt, cr1);
+
+         // descale
+         __m256i rw = _mm256_srai_epi16(rws, 4);
+         __m256i bw = _mm256_srai_epi16(bws, 4);
+         __m256i gw = _mm256_srai_epi16(gws, 4);
+
+         // back to byte and interleave. everything so far stayed within
+         // 128-bit lanes, so o0 holds pixels 0-3/8-11 and o1 holds 4-7/12-15.
+         __m256i brb = _mm256_packus_epi16(rw, bw);
+         __m256i gxb = _mm256_packus_epi16(gw, xw);
+         __m256i t0 = _mm256_unpacklo_epi8(brb, gxb);
+         __m256i t1 = _mm256_unpackhi_epi8(brb, gxb);
+         __m256i o0 = _mm256_unpacklo_epi16(t0, t1);
+         __m256i o1 = _mm256_unpackhi_epi16(t0, t1);
+
+         // store
+         _mm256_storeu_si256((__m256i *) (out + 0), _mm256_permute2x128_si256(o0, o1, 0x20));
+         _mm256_storeu_si256((__m256i *) (out + 32), _mm256_permute2x128_si256(o0, o1, 0x31));
+         out += 64;
+      }
+   }
+
+   stbi__YCbCr_to_RGB_row(out, y+i, pcb+i, pcr+i, count-i, step);
+}
+
+static STBI__TARGET_AVX512 void stbi__YCbCr_to_RGB_avx512(stbi_uc *out, stbi_uc const *y, stbi_uc const *pcb, stbi_uc const *pcr, int count, int step)
+{
+   int i = 0;
+
+   if (step == 4) {
+      __m512i cr_const0 = _mm512_set1_epi16(   (short) ( 1.40200f*4096.0f+0.5f));
+      __m512i cr_const1 = _mm512_set1_epi16( - (short) ( 0.71414f*4096.0f+0.5f));
+      __m512i cb_const0 = _mm512_set1_epi16( - (short) ( 0.34414f*4096.0f+0.5f));
+      __m512i cb_const1 = _mm512_set1_epi16(   (short) ( 1.77200f*4096.0f+0.5f));
+      __m512i bias = _mm512_set1_epi16(128);
+      __m512i xw = _mm512_set1_epi16(255); // alpha channel
+
+      // qword order that puts the four 128-bit lanes of o0/o1 back in pixel order
+      __m512i lo = _mm512_setr_epi64(0, 1, 8, 9, 2, 3, 10, 11);
+      __m512i hi = _mm512_setr_epi64(4, 5, 12, 13, 6, 7, 14, 15);
+
+      for (; i+31 < count; i += 32) {
+         __m512i yb  = _mm512_cvtepu8_epi16(_mm256_loadu_si256((__m256i *) (y+i)));
+         __m512i crb = _mm512_cvtepu8_epi16(_mm256_loadu_si256((__m256i *) (pcr+i)));
+         __m512i cbb = _mm512_cvtepu8_epi16(_mm256_loadu_si256((__m256i *) (pcb+i)));
+         __m512i yw  = _mm512_or_si512(_mm512_slli_epi16(yb, 8), bias);
+         __m512i crw = _mm512_slli_epi16(_mm512_sub_epi16(crb, bias), 8);
+         __m512i cbw = _mm512_slli_epi16(_mm512_sub_epi16(cbb, bias), 8);
+
+         __m512i yws = _mm512_srli_epi16(yw, 4);
+         __m512i cr0 = _mm512_mulhi_epi16(cr_const0, crw);
+         __m512i cb0 = _mm512_mulhi_epi16(cb_const0, cbw);
+         __m512i cb1 = _mm512_mulhi_epi16(cbw, cb_const1);
+         __m512i cr1 = _mm512_mulhi_epi16(crw, cr_const1);
+         __m512i rws = _mm512_add_epi16(cr0, yws);
+         __m512i gwt = _mm512_add_epi16(cb0, yws);
+         __m512i bws = _mm512_add_epi16(yws, cb1);
+         __m512i gws = _mm512_add_epi16(gwt, cr1);
+
+         __m512i rw = _mm512_srai_epi16(rws, 4);
+         __m512i bw = _mm512_srai_epi16(bws, 4);
+         __m512i gw = _mm512_srai_epi16(gws, 4);
+
+         __m512i brb = _mm512_packus_epi16(rw, bw);
+         __m512i gxb = _mm512_packus_epi16(gw, xw);
+         __m512i t0 = _mm512_unpacklo_epi8(brb, gxb);
+         __m512i t1 = _mm512_unpackhi_epi8(brb, gxb);
+         __m512i o0 = _mm512_unpacklo_epi16(t0, t1);
+         __m512i o1 = _mm512_unpackhi_epi16(t0, t1);
+
+         _mm512_storeu_si512((void *) (out + 0), _mm512_permutex2var_epi64(o0, lo, o1));
+         _mm512_storeu_si512((void *) (out + 64), _mm512_permutex2var_epi64(o0, hi, o1));
+         out += 128;
+      }
+   }
+
+   stbi__YCbCr_to_RGB_row(out, y+i, pcb+i, pcr+i, count-i, step);
+}
+#endif
+
 // set up the kernels
 static void stbi__setup_jpeg(stbi__jpeg *j)
 {
@@ -3771,17 +4417,33 @@ static void stbi__setup_jpeg(stbi__jpeg *j)
    j->resample_row_hv_2_kernel = stbi__resample_row_hv_2;
 
 #ifdef STBI_SSE2
-   if (stbi__sse2_available()) {
+   if (stbi__jpeg_simd_level >= 1 && stbi__sse2_available()) {
       j->idct_block_kernel = stbi__idct_simd;
       j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
       j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_simd;
    }
 #endif
 
+#ifdef STBI_AVX2
+   if (stbi__jpeg_simd_level >= 2 && stbi__avx2_available()) {
+      j->idct_block_kernel = stbi__idct_avx2;
+      j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_avx2;
+      j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_avx2;
+   }
+
+   // an 8x8 block doesn't fill a 512-bit register, so the IDCT stays avx2
+   if (stbi__jpeg_simd_level >= 3 && stbi__avx512_available()) {
+      j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_avx512;
+      j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_avx512;
+   }
+#endif
+
 #ifdef STBI_NEON
-   j->idct_block_kernel = stbi__idct_simd;
-   j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
-   j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_simd;
+   if (stbi__jpeg_simd_level >= 1) {
+      j->idct_block_kernel = stbi__idct_simd;
+      j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
+      j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_simd;
+   }
 #endif
 }
 
@@ -3808,6 +4470,152 @@ static stbi_uc stbi__blinn_8x8(stbi_uc x, stbi_uc y)
    return (stbi_uc) ((t + (t >>8)) >> 8);
 }
 
+// resample and color-convert output rows [y0, y1). res_comp holds the
+// resampling state for row 0; it is advanced to y0 on a copy, so bands of
+// rows can be converted independently and in any order. the converters may
+// write one byte past a row, so with a scratch row the band's last row goes
+// through it instead of touching the next band.
+static void stbi__jpeg_output_rows(stbi__jpeg *z, stbi__resample *res_comp, stbi_uc **linebuf, stbi_uc *scratch, stbi_uc *output, int n, int decode_n, int is_rgb, unsigned int y0, unsigned int y1)
+{
+   int k;
+   unsigned int i,j;
+   stbi_uc *coutput[4] = { NULL, NULL, NULL, NULL };
+   stbi__resample res[4];
+
+   for (k=0; k < decode_n; ++k) {
+      stbi__resample *r = &res[k];
+      int steps = res_comp[k].ystep + (int) y0;
+      int wraps = steps / res_comp[k].vs;
+      int last  = z->img_comp[k].y - 1;
+      int row0  = wraps > 0 ? wraps-1 : 0;
+      *r = res_comp[k];
+      r->ystep = steps % r->vs;
+      r->ypos  = wraps;
+      r->line0 = z->img_comp[k].data + z->img_comp[k].w2 * (row0 < last ? row0 : last);
+      r->line1 = z->img_comp[k].data + z->img_comp[k].w2 * (wraps < last ? wraps : last);
+   }
+
+   for (j=y0; j < y1; ++j) {
+      stbi_uc *row = scratch && j+1 == y1 ? scratch : output + n * z->s->img_x * j;
+      stbi_uc *out = row;
+      for (k=0; k < decode_n; ++k) {
+         stbi__resample *r = &res[k];
+         int y_bot = r->ystep >= (r->vs >> 1);
+         coutput[k] = r->resample(linebuf[k],
+                                  y_bot ? r->line1 : r->line0,
+                                  y_bot ? r->line0 : r->line1,
+                                  r->w_lores, r->hs);
+         if (++r->ystep >= r->vs) {
+            r->ystep = 0;
+            r->line0 = r->line1;
+            if (++r->ypos < z->img_comp[k].y)
+               r->line1 += z->img_comp[k].w2;
+         }
+      }
+      if (n >= 3) {
+         stbi_uc *y = coutput[0];
+         if (z->s->img_n == 3) {
+            if (is_rgb) {
+               for (i=0; i < z->s->img_x; ++i) {
+                  out[0] = y[i];
+                  out[1] = coutput[1][i];
+                  out[2] = coutput[2][i];
+                  out[3] = 255;
+                  out += n;
+               }
+            } else {
+               z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+            }
+         } else if (z->s->img_n == 4) {
+            if (z->app14_color_transform == 0) { // CMYK
+               for (i=0; i < z->s->img_x; ++i) {
+                  stbi_uc m = coutput[3][i];
+                  out[0] = stbi__blinn_8x8(coutput[0][i], m);
+                  out[1] = stbi__blinn_8x8(coutput[1][i], m);
+                  out[2] = stbi__blinn_8x8(coutput[2][i], m);
+                  out[3] = 255;
+                  out += n;
+               }
+            } else if (z->app14_color_transform == 2) { // YCCK
+               z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+               for (i=0; i < z->s->img_x; ++i) {
+                  stbi_uc m = coutput[3][i];
+                  out[0] = stbi__blinn_8x8(255 - out[0], m);
+                  out[1] = stbi__blinn_8x8(255 - out[1], m);
+                  out[2] = stbi__blinn_8x8(255 - out[2], m);
+                  out += n;
+               }
+            } else { // YCbCr + alpha?  Ignore the fourth channel for now
+               z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+            }
+         } else
+            for (i=0; i < z->s->img_x; ++i) {
+               out[0] = out[1] = out[2] = y[i];
+               out[3] = 255; // not used if n==3
+               out += n;
+            }
+      } else {
+         if (is_rgb) {
+            if (n == 1)
+               for (i=0; i < z->s->img_x; ++i)
+                  *out++ = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
+            else {
+               for (i=0; i < z->s->img_x; ++i, out += 2) {
+                  out[0] = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
+                  out[1] = 255;
+               }
+            }
+         } else if (z->s->img_n == 4 && z->app14_color_transform == 0) {
+            for (i=0; i < z->s->img_x; ++i) {
+               stbi_uc m = coutput[3][i];
+               stbi_uc r = stbi__blinn_8x8(coutput[0][i], m);
+               stbi_uc g = stbi__blinn_8x8(coutput[1][i], m);
+               stbi_uc b = stbi__blinn_8x8(coutput[2][i], m);
+               out[0] = stbi__compute_y(r, g, b);
+               out[1] = 255;
+               out += n;
+            }
+         } else if (z->s->img_n == 4 && z->app14_color_transform == 2) {
+            for (i=0; i < z->s->img_x; ++i) {
+               out[0] = stbi__blinn_8x8(255 - coutput[0][i], coutput[3][i]);
+               out[1] = 255;
+               out += n;
+            }
+         } else {
+            stbi_uc *y = coutput[0];
+            if (n == 1)
+               for (i=0; i < z->s->img_x; ++i) out[i] = y[i];
+            else
+               for (i=0; i < z->s->img_x; ++i) { *out++ = y[i]; *out++ = 255; }
+         }
+      }
+      if (row == scratch)
+         memcpy(output + n * z->s->img_x * j, scratch, n * z->s->img_x);
+   }
+}
+
+typedef struct
+{
+   stbi__jpeg *z;
+   stbi__resample *res_comp;
+   stbi_uc *output, *bands; // per band: line buffers, then a scratch row
+   int n, decode_n, is_rgb, tasks, band_bytes;
+} stbi__jpeg_output;
+
+static void stbi__jpeg_output_band(void *ctx, int index)
+{
+   stbi__jpeg_output *o = (stbi__jpeg_output *) ctx;
+   stbi__jpeg *z = o->z;
+   stbi_uc *band = o->bands ? o->bands + (size_t) index * o->band_bytes : NULL;
+   stbi_uc *linebuf[4];
+   int k;
+   for (k=0; k < o->decode_n; ++k)
+      linebuf[k] = band ? band + k * (z->s->img_x + 3) : z->img_comp[k].linebuf;
+   stbi__jpeg_output_rows(z, o->res_comp, linebuf, band ? band + o->decode_n * (z->s->img_x + 3) : NULL,
+                          o->output, o->n, o->decode_n, o->is_rgb,
+                          z->s->img_y * index / o->tasks, z->s->img_y * (index+1) / o->tasks);
+}
+
 static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp, int req_comp)
 {
    int n, decode_n, is_rgb;
@@ -3836,9 +4644,8 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
    // resample and color-convert
    {
       int k;
-      unsigned int i,j;
       stbi_uc *output;
-      stbi_uc *coutput[4] = { NULL, NULL, NULL, NULL };
+      stbi__jpeg_output conv;
 
       stbi__resample res_comp[4];
 
@@ -3869,100 +4676,22 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
       if (!output) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
 
       // now go ahead and resample
-      for (j=0; j < z->s->img_y; ++j) {
-         stbi_uc *out = output + n * z->s->img_x * j;
-         for (k=0; k < decode_n; ++k) {
-            stbi__resample *r = &res_comp[k];
-            int y_bot = r->ystep >= (r->vs >> 1);
-            coutput[k] = r->resample(z->img_comp[k].linebuf,
-                                     y_bot ? r->line1 : r->line0,
-                                     y_bot ? r->line0 : r->line1,
-                                     r->w_lores, r->hs);
-            if (++r->ystep >= r->vs) {
-               r->ystep = 0;
-               r->line0 = r->line1;
-               if (++r->ypos < z->img_comp[k].y)
-                  r->line1 += z->img_comp[k].w2;
-            }
-         }
-         if (n >= 3) {
-            stbi_uc *y = coutput[0];
-            if (z->s->img_n == 3) {
-               if (is_rgb) {
-                  for (i=0; i < z->s->img_x; ++i) {
-                     out[0] = y[i];
-                     out[1] = coutput[1][i];
-                     out[2] = coutput[2][i];
-                     out[3] = 255;
-                     out += n;
-                  }
-               } else {
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-               }
-            } else if (z->s->img_n == 4) {
-               if (z->app14_color_transform == 0) { // CMYK
-                  for (i=0; i < z->s->img_x; ++i) {
-                     stbi_uc m = coutput[3][i];
-                     out[0] = stbi__blinn_8x8(coutput[0][i], m);
-                     out[1] = stbi__blinn_8x8(coutput[1][i], m);
-                     out[2] = stbi__blinn_8x8(coutput[2][i], m);
-                     out[3] = 255;
-                     out += n;
-                  }
-               } else if (z->app14_color_transform == 2) { // YCCK
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-                  for (i=0; i < z->s->img_x; ++i) {
-                     stbi_uc m = coutput[3][i];
-                     out[0] = stbi__blinn_8x8(255 - out[0], m);
-                     out[1] = stbi__blinn_8x8(255 - out[1], m);
-                     out[2] = stbi__blinn_8x8(255 - out[2], m);
-                     out += n;
-                  }
-               } else { // YCbCr + alpha?  Ignore the fourth channel for now
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-               }
-            } else
-               for (i=0; i < z->s->img_x; ++i) {
-                  out[0] = out[1] = out[2] = y[i];
-                  out[3] = 255; // not used if n==3
-                  out += n;
-               }
-         } else {
-            if (is_rgb) {
-               if (n == 1)
-                  for (i=0; i < z->s->img_x; ++i)
-                     *out++ = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
-               else {
-                  for (i=0; i < z->s->img_x; ++i, out += 2) {
-                     out[0] = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
-                     out[1] = 255;
-                  }
-               }
-            } else if (z->s->img_n == 4 && z->app14_color_transform == 0) {
-               for (i=0; i < z->s->img_x; ++i) {
-                  stbi_uc m = coutput[3][i];
-                  stbi_uc r = stbi__blinn_8x8(coutput[0][i], m);
-                  stbi_uc g = stbi__blinn_8x8(coutput[1][i], m);
-                  stbi_uc b = stbi__blinn_8x8(coutput[2][i], m);
-                  out[0] = stbi__compute_y(r, g, b);
-                  out[1] = 255;
-                  out += n;
-               }
-            } else if (z->s->img_n == 4 && z->app14_color_transform == 2) {
-               for (i=0; i < z->s->img_x; ++i) {
-                  out[0] = stbi__blinn_8x8(255 - coutput[0][i], coutput[3][i]);
-                  out[1] = 255;
-                  out += n;
-               }
-            } else {
-               stbi_uc *y = coutput[0];
-               if (n == 1)
-                  for (i=0; i < z->s->img_x; ++i) out[i] = y[i];
-               else
-                  for (i=0; i < z->s->img_x; ++i) { *out++ = y[i]; *out++ = 255; }
-            }
-         }
+      conv.z = z;
+      conv.res_comp = res_comp;
+      conv.output = output;
+      conv.n = n;
+      conv.decode_n = decode_n;
+      conv.is_rgb = is_rgb;
+      conv.tasks = stbi__parallel_tasks(z->s->img_x, z->s->img_y, z->s->img_y / 16);
+      conv.bands = NULL;
+      if (conv.tasks > 1) {
+         // every band needs its own line buffers and scratch row
+         conv.band_bytes = decode_n * (z->s->img_x + 3) + n * z->s->img_x + 1;
+         conv.bands = (stbi_uc *) stbi__malloc_mad2(conv.tasks, conv.band_bytes, 0);
+         if (!conv.bands) conv.tasks = 1;
       }
+      stbi__parallel(stbi__jpeg_output_band, &conv, conv.tasks);
+      if (conv.bands) STBI_FREE(conv.bands);
       stbi__cleanup_jpeg(z);
       *out_x = z->s->img_x;
       *out_y = z->s->img_y;
@@ -4590,13 +5319,15 @@ static int stbi__paeth(int a, int b, int c)
 
 static const stbi_uc stbi__depth_scale_table[9] = { 0, 0xff, 0x55, 0, 0x11, 0,0,0, 0x01 };
 
-// create the png data from post-deflated data
-static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 raw_len, int out_n, stbi__uint32 x, stbi__uint32 y, int depth, int color)
+// unfilter rows [y0, y1) of a pass into a->out, then expand them to 8 bits
+// or swap them to native 16-bit. raw points at the filter byte of row y0,
+// which must not depend on the row above unless y0 is 0.
+static int stbi__png_unfilter_rows(stbi__png *a, stbi_uc *raw, int out_n, stbi__uint32 x, stbi__uint32 y0, stbi__uint32 y1, int depth, int color)
 {
    int bytes = (depth == 16? 2 : 1);
    stbi__context *s = a->s;
    stbi__uint32 i,j,stride = x*out_n*bytes;
-   stbi__uint32 img_len, img_width_bytes;
+   stbi__uint32 img_width_bytes = (((s->img_n * x * depth) + 7) >> 3);
    int k;
    int img_n = s->img_n; // copy it into a local for later
 
@@ -4604,20 +5335,7 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
    int filter_bytes = img_n*bytes;
    int width = x;
 
-   STBI_ASSERT(out_n == s->img_n || out_n == s->img_n+1);
-   a->out = (stbi_uc *) stbi__malloc_mad3(x, y, output_bytes, 0); // extra bytes to write off the end into
-   if (!a->out) return stbi__err("outofmem", "Out of memory");
-
-   if (!stbi__mad3sizes_valid(img_n, x, depth, 7)) return stbi__err("too large", "Corrupt PNG");
-   img_width_bytes = (((img_n * x * depth) + 7) >> 3);
-   img_len = (img_width_bytes + 1) * y;
-
-   // we used to check for exact match between raw_len and img_len on non-interlaced PNGs,
-   // but issue #276 reported a PNG in the wild that had extra data at the end (all zeros),
-   // so just check for raw_len < img_len always.
-   if (raw_len < img_len) return stbi__err("not enough pixels","Corrupt PNG");
-
-   for (j=0; j < y; ++j) {
+   for (j=y0; j < y1; ++j) {
       stbi_uc *cur = a->out + stride*j;
       stbi_uc *prior;
       int filter = *raw++;
@@ -4719,7 +5437,7 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
    // this could run two scanlines behind the above code, so it won't
    // intefere with filtering but will still be in the cache.
    if (depth < 8) {
-      for (j=0; j < y; ++j) {
+      for (j=y0; j < y1; ++j) {
          stbi_uc *cur = a->out + stride*j;
          stbi_uc *in  = a->out + stride*j + x*out_n - img_width_bytes;
          // unpack 1/2/4-bit into a 8-bit buffer. allows us to keep the common 8-bit path optimal at minimal cost for 1/2/4-bit
@@ -4792,10 +5510,10 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
       // this is done in a separate pass due to the decoding relying
       // on the data being untouched, but could probably be done
       // per-line during decode if care is taken.
-      stbi_uc *cur = a->out;
+      stbi_uc *cur = a->out + stride*y0;
       stbi__uint16 *cur16 = (stbi__uint16*)cur;
 
-      for(i=0; i < x*y*out_n; ++i,cur16++,cur+=2) {
+      for(i=0; i < x*(y1-y0)*out_n; ++i,cur16++,cur+=2) {
          *cur16 = (cur[0] << 8) | cur[1];
       }
    }
@@ -4803,6 +5521,86 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
    return 1;
 }
 
+typedef struct
+{
+   stbi__png *a;
+   stbi_uc *raw;
+   stbi__uint32 *rows; // first row of each block, plus the end
+   stbi__uint32 x, row_bytes;
+   int out_n, depth, color;
+   stbi_uc failed[STBI_PARALLEL_TASKS]; // per task, combined once all are done
+} stbi__png_blocks;
+
+static void stbi__png_unfilter_block(void *ctx, int index)
+{
+   stbi__png_blocks *b = (stbi__png_blocks *) ctx;
+   stbi_uc *raw = b->raw + (size_t) b->rows[index] * b->row_bytes;
+   if (!stbi__png_unfilter_rows(b->a, raw, b->out_n, b->x, b->rows[index], b->rows[index+1], b->depth, b->color))
+      b->failed[index] = 1;
+}
+
+// create the png data from post-deflated data
+static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 raw_len, int out_n, stbi__uint32 x, stbi__uint32 y, int depth, int color)
+{
+   int bytes = (depth == 16? 2 : 1);
+   stbi__context *s = a->s;
+   stbi__uint32 img_len, img_width_bytes;
+   int img_n = s->img_n; // copy it into a local for later
+   int output_bytes = out_n*bytes;
+   stbi__png_blocks b;
+   int tasks, i, failed = 0;
+
+   STBI_ASSERT(out_n == s->img_n || out_n == s->img_n+1);
+   a->out = (stbi_uc *) stbi__malloc_mad3(x, y, output_bytes, 0); // extra bytes to write off the end into
+   if (!a->out) return stbi__err("outofmem", "Out of memory");
+
+   if (!stbi__mad3sizes_valid(img_n, x, depth, 7)) return stbi__err("too large", "Corrupt PNG");
+   img_width_bytes = (((img_n * x * depth) + 7) >> 3);
+   img_len = (img_width_bytes + 1) * y;
+
+   // we used to check for exact match between raw_len and img_len on non-interlaced PNGs,
+   // but issue #276 reported a PNG in the wild that had extra data at the end (all zeros),
+   // so just check for raw_len < img_len always.
+   if (raw_len < img_len) return stbi__err("not enough pixels","Corrupt PNG");
+
+   tasks = stbi__parallel_tasks(x, y, y / 16);
+   if (tasks < 2)
+      return stbi__png_unfilter_rows(a, raw, out_n, x, 0, y, depth, color);
+
+   // rows filtered with none or sub don't read the row above, so a block can
+   // start at any of them. cut at the first such row past each 1/tasks mark.
+   b.rows = (stbi__uint32 *) stbi__malloc_mad2(tasks + 1, sizeof(stbi__uint32), 0);
+   if (!b.rows) return stbi__png_unfilter_rows(a, raw, out_n, x, 0, y, depth, color);
+   {
+      int n = 1;
+      stbi__uint32 j;
+      b.rows[0] = 0;
+      for (j=1; j < y && n < tasks; ++j) {
+         int filter = raw[(size_t) j * (img_width_bytes + 1)];
+         if (j >= (stbi__uint32) ((double) y * n / tasks) && (filter == STBI__F_none || filter == STBI__F_sub))
+            b.rows[n++] = j;
+      }
+      b.rows[n] = y;
+      tasks = n;
+   }
+
+   b.a = a;
+   b.raw = raw;
+   b.x = x;
+   b.row_bytes = img_width_bytes + 1;
+   b.out_n = out_n;
+   b.depth = depth;
+   b.color = color;
+   memset(b.failed, 0, sizeof(b.failed));
+   stbi__parallel(stbi__png_unfilter_block, &b, tasks);
+   STBI_FREE(b.rows);
+
+   for (i=0; i < tasks; ++i)
+      failed |= b.failed[i];
+   if (failed) return stbi__err("invalid filter","Corrupt PNG");
+   return 1;
+}
+
 static int stbi__create_png_image(stbi__png *a, stbi_uc *image_data, stbi__uint32 image_data_len, int out_n, int depth, int color, int interlaced)
 {
    int bytes = (depth == 16 ? 2 : 1);
@@ -0,0 +1,86 @@
+#version 430 core
+
+// one invocation per object: test its world bounds against the frustum and
+// append a draw command and instance matrix for it when it's visible
+
+layout (local_size_x = 64) in;
+
+#include "framedata.glsl"
+
+struct Object {
+    mat4 model;
+    vec4 boundsMin;
+    vec4 boundsMax;
+    uint indexCount;
+    uint firstIndex;
+    int baseVertex;
+    uint pad;
+};
+
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout (std430, binding = 2) readonly buffer Objects {
+    Object objects[];
+};
+
+layout (std430, binding = 3) writeonly buffer Commands {
+    DrawCommand commands[];
+};
+
+layout (std430, binding = 4) writeonly buffer Visible {
+    mat4 visible[];
+};
+
+// drawCount is reset to zero and objectCount set before every dispatch
+layout (std430, binding = 5) buffer DrawCount {
+    uint drawCount;
+    uint objectCount;
+};
+
+bool inFrustum(vec3 center, vec3 extent)
+{
+    // planes straight from the rows of the view-projection matrix
+    mat4 m = transpose(viewProjection);
+    vec4 planes[6] = vec4[6](
+        m[3] + m[0], m[3] - m[0],
+        m[3] + m[1], m[3] - m[1],
+        m[3] + m[2], m[3] - m[2]
+    );
+
+    for (int i = 0; i < 6; i++) {
+        // distance of the box's most positive corner along the plane normal
+        float d = dot(planes[i].xyz, center) + planes[i].w + dot(abs(planes[i].xyz), extent);
+        if (d < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+void main()
+{
+    uint id = gl_GlobalInvocationID.x;
+    if (id >= objectCount)
+        return;
+
+    Object obj = objects[id];
+
+    // world-space box around the transformed local box
+    vec3 localCenter = 0.5f * (obj.boundsMin.xyz + obj.boundsMax.xyz);
+    vec3 localExtent = 0.5f * (obj.boundsMax.xyz - obj.boundsMin.xyz);
+    vec3 center = (obj.model * vec4(localCenter, 1.0f)).xyz;
+    mat3 absModel = mat3(abs(obj.model[0].xyz), abs(obj.model[1].xyz), abs(obj.model[2].xyz));
+    vec3 extent = absModel * localExtent;
+
+    if (!inFrustum(center, extent))
+        return;
+
+    uint slot = atomicAdd(drawCount, 1u);
+    commands[slot] = DrawCommand(obj.indexCount, 1u, obj.firstIndex, obj.baseVertex, slot);
+    visible[slot] = obj.model;
+}
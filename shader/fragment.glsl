@@ -2,6 +2,7 @@
 
 in vec4 vertColor;
 in vec2 texCoord;
+in vec3 normal;
 
 out vec4 fragColor;
 
@@ -10,4 +11,15 @@ uniform sampler2D ourTexture;
 void main()
 {
     fragColor = texture(ourTexture, texCoord);
+
+    // simple directional light for meshes that carry normals
+    if (dot(normal, normal) > 0.0f) {
+        float diffuse = max(dot(normalize(normal), normalize(vec3(0.3f, 1.0f, 0.5f))), 0.0f);
+        fragColor.rgb *= 0.3f + 0.7f * diffuse;
+    }
+
+#ifdef ALPHA_TEST
+    if (fragColor.a < 0.5f)
+        discard;
+#endif
 }
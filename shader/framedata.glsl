@@ -0,0 +1,8 @@
+// per-frame uniform block, mirrors framedata in shader.h
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 viewport;
+    float time;
+};
@@ -2,22 +2,38 @@
 
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoord;
+layout (location = 2) in mat4 aModel;
+layout (location = 6) in vec3 aNormal;
+
+// set when aNormal holds an octahedral snorm16x2 normal in .xy
+uniform bool octNormals;
 
 out vec4 vertColor;
 out vec2 texCoord;
+out vec3 normal;
 
-uniform float time;
+#include "framedata.glsl"
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// unfold an octahedral encoding back onto the unit sphere
+vec3 oct_decode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+    if (n.z < 0.0f)
+        n.xy = (1.0f - abs(n.yx)) * vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+    return normalize(n);
+}
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0f);
+    gl_Position = viewProjection * aModel * vec4(aPos, 1.0f);
 
     vec3 col = 0.5f + 0.5f * cos(time + aPos.xyx + vec3(0, 2, 4));
     vertColor = vec4(col, 1.0f);
 
     texCoord = aTexCoord;
+
+    // world-space normal, zero for meshes without one. aModel carries the
+    // mesh's non-uniform dequantisation scale, so normals take its inverse transpose
+    mat3 normalMatrix = transpose(inverse(mat3(aModel)));
+    normal = normalMatrix * (octNormals ? oct_decode(aNormal.xy) : aNormal);
 }
@@ -0,0 +1,65 @@
+#include "bench.h"
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+bench bench_create(int frames)
+{
+    bench b;
+    b.times = (double *) malloc(frames * sizeof(double));
+    b.len = 0;
+    b.cap = frames;
+    b.draws = 0;
+
+    return b;
+}
+
+void bench_frame(bench *b, double seconds, unsigned long draws)
+{
+    if (b->len >= b->cap) return;
+
+    b->times[b->len++] = seconds;
+    b->draws += draws;
+}
+
+void bench_report(bench *b, FILE *fp)
+{
+    if (b->len == 0) {
+        fprintf(fp, "{\"frames\": 0}\n");
+        return;
+    }
+
+    // sort a copy so the recorded order is kept
+    double *sorted = (double *) malloc(b->len * sizeof(double));
+    double total = 0;
+
+    for (int i = 0; i < b->len; i++) {
+        sorted[i] = b->times[i];
+        total += b->times[i];
+    }
+    qsort(sorted, b->len, sizeof(double), cmp_double);
+
+    // nearest-rank percentiles
+    double min = sorted[0];
+    double median = sorted[(b->len - 1) / 2];
+    double p99 = sorted[(int) (0.99 * (b->len - 1) + 0.5)];
+
+    fprintf(fp,
+        "{\"frames\": %d, \"min_ms\": %.4f, \"median_ms\": %.4f, \"p99_ms\": %.4f, "
+        "\"mean_ms\": %.4f, \"draws\": %lu, \"draws_per_sec\": %.1f}\n",
+        b->len, min * 1000.0, median * 1000.0, p99 * 1000.0,
+        total / b->len * 1000.0, b->draws, total > 0 ? b->draws / total : 0.0);
+
+    free(sorted);
+}
+
+void bench_destroy(bench *b)
+{
+    free(b->times);
+    b->times = NULL;
+    b->len = b->cap = 0;
+}
@@ -45,3 +45,9 @@ void cam_lookat(camera *cam, vec3 target)
     cam->eulers[ROLL] = glm_deg(atan2(-cam->view[2][0], sqrt(pow(cam->view[2][1], 2) + pow(cam->view[2][2], 2))));
     cam->eulers[YAW] = glm_deg(atan2(cam->view[1][0], cam->view[0][0]));
 }
+
+void cam_frustum(mat4 viewProjection, frustum *f)
+{
+    // planes straight from the rows of the matrix (gribb/hartmann)
+    glm_frustum_planes(viewProjection, f->planes);
+}
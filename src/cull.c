@@ -0,0 +1,198 @@
+#include <cull.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CULL_X86 1
+#endif
+
+int cull_create(cullbounds *b, int count)
+{
+    b->len = count;
+    b->cap = (count + 7) & ~7;
+
+    // a range starting anywhere may read up to 7 boxes past its end
+    int alloc = b->cap + 8;
+
+    b->cx = b->cy = b->cz = b->ex = b->ey = b->ez = NULL;
+
+    float **arrays[] = { &b->cx, &b->cy, &b->cz, &b->ex, &b->ey, &b->ez };
+    for (int i = 0; i < 6; i++) {
+        *arrays[i] = (float *) aligned_alloc(32, alloc * sizeof(float));
+        if (*arrays[i] == NULL) {
+            fprintf(stderr, "Failed to allocate cull bounds.\n");
+            cull_destroy(b);
+            return 0;
+        }
+    }
+
+    // padding: a negative extent pushes the box behind every plane
+    for (int i = 0; i < alloc; i++) {
+        b->cx[i] = b->cy[i] = b->cz[i] = 0.0f;
+        b->ex[i] = b->ey[i] = b->ez[i] = -INFINITY;
+    }
+
+    return 1;
+}
+
+void cull_set(cullbounds *b, int i, const float center[3], const float extent[3])
+{
+    b->cx[i] = center[0];
+    b->cy[i] = center[1];
+    b->cz[i] = center[2];
+    b->ex[i] = extent[0];
+    b->ey[i] = extent[1];
+    b->ez[i] = extent[2];
+}
+
+void cull_setBox(cullbounds *b, int i, mat4 model, const float localMin[3], const float localMax[3])
+{
+    // world box around the transformed local box: centre goes through the
+    // matrix, extent through its absolute value
+    float c[3], e[3], center[3], extent[3];
+    for (int k = 0; k < 3; k++) {
+        c[k] = 0.5f * (localMin[k] + localMax[k]);
+        e[k] = 0.5f * (localMax[k] - localMin[k]);
+    }
+
+    for (int r = 0; r < 3; r++) {
+        center[r] = model[3][r] + model[0][r] * c[0] + model[1][r] * c[1] + model[2][r] * c[2];
+        extent[r] = fabsf(model[0][r]) * e[0] + fabsf(model[1][r]) * e[1] + fabsf(model[2][r]) * e[2];
+    }
+
+    cull_set(b, i, center, extent);
+}
+
+/*
+ * A box is outside when, for some plane, even its corner furthest along
+ * the plane normal is behind it:  n.c + w + |n|.e < 0
+ */
+
+#ifndef CULL_X86
+
+static int cull_scalar(const cullbounds *b, const frustum *f, int first, int len, uint32_t *visible)
+{
+    int count = 0;
+
+    for (int i = first; i < first + len; i++) {
+        int inside = 1;
+        for (int p = 0; p < 6 && inside; p++) {
+            const float *n = f->planes[p];
+            float d = n[0] * b->cx[i] + n[1] * b->cy[i] + n[2] * b->cz[i] + n[3]
+                    + fabsf(n[0]) * b->ex[i] + fabsf(n[1]) * b->ey[i] + fabsf(n[2]) * b->ez[i];
+            inside = d >= 0.0f;
+        }
+        if (inside)
+            visible[count++] = i;
+    }
+
+    return count;
+}
+
+#else
+
+static int cull_sse(const cullbounds *b, const frustum *f, int first, int len, uint32_t *visible)
+{
+    __m128 n[6][4], a[6][3];
+    for (int p = 0; p < 6; p++) {
+        for (int k = 0; k < 4; k++)
+            n[p][k] = _mm_set1_ps(f->planes[p][k]);
+        for (int k = 0; k < 3; k++)
+            a[p][k] = _mm_set1_ps(fabsf(f->planes[p][k]));
+    }
+
+    int count = 0;
+    for (int i = first; i < first + len; i += 4) {
+        __m128 cx = _mm_loadu_ps(b->cx + i), cy = _mm_loadu_ps(b->cy + i), cz = _mm_loadu_ps(b->cz + i);
+        __m128 ex = _mm_loadu_ps(b->ex + i), ey = _mm_loadu_ps(b->ey + i), ez = _mm_loadu_ps(b->ez + i);
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+        for (int p = 0; p < 6; p++) {
+            __m128 d = _mm_add_ps(_mm_mul_ps(n[p][0], cx), n[p][3]);
+            d = _mm_add_ps(d, _mm_mul_ps(n[p][1], cy));
+            d = _mm_add_ps(d, _mm_mul_ps(n[p][2], cz));
+            d = _mm_add_ps(d, _mm_mul_ps(a[p][0], ex));
+            d = _mm_add_ps(d, _mm_mul_ps(a[p][1], ey));
+            d = _mm_add_ps(d, _mm_mul_ps(a[p][2], ez));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, _mm_setzero_ps()));
+        }
+
+        // boxes past the end of the range don't count
+        int mask = _mm_movemask_ps(inside);
+        if (first + len - i < 4)
+            mask &= (1 << (first + len - i)) - 1;
+
+        for (; mask; mask &= mask - 1)
+            visible[count++] = i + __builtin_ctz(mask);
+    }
+
+    return count;
+}
+
+__attribute__((target("avx")))
+static int cull_avx(const cullbounds *b, const frustum *f, int first, int len, uint32_t *visible)
+{
+    __m256 n[6][4], a[6][3];
+    for (int p = 0; p < 6; p++) {
+        for (int k = 0; k < 4; k++)
+            n[p][k] = _mm256_set1_ps(f->planes[p][k]);
+        for (int k = 0; k < 3; k++)
+            a[p][k] = _mm256_set1_ps(fabsf(f->planes[p][k]));
+    }
+
+    int count = 0;
+    for (int i = first; i < first + len; i += 8) {
+        __m256 cx = _mm256_loadu_ps(b->cx + i), cy = _mm256_loadu_ps(b->cy + i), cz = _mm256_loadu_ps(b->cz + i);
+        __m256 ex = _mm256_loadu_ps(b->ex + i), ey = _mm256_loadu_ps(b->ey + i), ez = _mm256_loadu_ps(b->ez + i);
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+        for (int p = 0; p < 6; p++) {
+            __m256 d = _mm256_add_ps(_mm256_mul_ps(n[p][0], cx), n[p][3]);
+            d = _mm256_add_ps(d, _mm256_mul_ps(n[p][1], cy));
+            d = _mm256_add_ps(d, _mm256_mul_ps(n[p][2], cz));
+            d = _mm256_add_ps(d, _mm256_mul_ps(a[p][0], ex));
+            d = _mm256_add_ps(d, _mm256_mul_ps(a[p][1], ey));
+            d = _mm256_add_ps(d, _mm256_mul_ps(a[p][2], ez));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+
+        int mask = _mm256_movemask_ps(inside);
+        if (first + len - i < 8)
+            mask &= (1 << (first + len - i)) - 1;
+
+        for (; mask; mask &= mask - 1)
+            visible[count++] = i + __builtin_ctz(mask);
+    }
+
+    return count;
+}
+
+#endif
+
+// writes the indices in [first, first + len) of the boxes at least partly inside, returns how many
+int cull_frustumRange(const cullbounds *b, const frustum *f, int first, int len, uint32_t *visible)
+{
+#ifdef CULL_X86
+    static int avx = -1;
+    if (avx < 0)
+        avx = __builtin_cpu_supports("avx");
+
+    return avx ? cull_avx(b, f, first, len, visible) : cull_sse(b, f, first, len, visible);
+#else
+    return cull_scalar(b, f, first, len, visible);
+#endif
+}
+
+int cull_frustum(const cullbounds *b, const frustum *f, uint32_t *visible)
+{
+    return cull_frustumRange(b, f, 0, b->len, visible);
+}
+
+void cull_destroy(cullbounds *b)
+{
+    free(b->cx); free(b->cy); free(b->cz);
+    free(b->ex); free(b->ey); free(b->ez);
+    b->cx = b->cy = b->cz = b->ex = b->ey = b->ez = NULL;
+    b->len = b->cap = 0;
+}
@@ -0,0 +1,124 @@
+#include <dds.h>
+#include <string.h>
+
+#define DDSD_CAPS        0x1
+#define DDSD_HEIGHT      0x2
+#define DDSD_WIDTH       0x4
+#define DDSD_PIXELFORMAT 0x1000
+#define DDSD_MIPMAPCOUNT 0x20000
+#define DDSD_LINEARSIZE  0x80000
+#define DDPF_FOURCC      0x4
+#define DDSCAPS_COMPLEX  0x8
+#define DDSCAPS_TEXTURE  0x1000
+#define DDSCAPS_MIPMAP   0x400000
+
+static int block_bytes(GLenum format)
+{
+    return format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? 8 : 16;
+}
+
+size_t dds_levelSize(const ddsinfo *info, int level)
+{
+    int w = info->width >> level;
+    int h = info->height >> level;
+    if (w < 1) w = 1;
+    if (h < 1) h = 1;
+
+    return (size_t) ((w + 3) / 4) * ((h + 3) / 4) * info->blockBytes;
+}
+
+int dds_parse(const unsigned char *data, size_t size, ddsinfo *info)
+{
+    uint32_t magic;
+    dds_header header;
+
+    if (size < 4 + sizeof(dds_header)) return 0;
+
+    memcpy(&magic, data, 4);
+    memcpy(&header, data + 4, sizeof(header));
+    if (magic != DDS_MAGIC || header.size != sizeof(dds_header)) return 0;
+
+    info->dataOffset = 4 + sizeof(dds_header);
+
+    uint32_t fourCC = header.ddspf.fourCC;
+    uint32_t dxgi = 0;
+
+    if (fourCC == DDS_FOURCC('D', 'X', '1', '0')) {
+        dds_header10 header10;
+        if (size < info->dataOffset + sizeof(header10)) return 0;
+
+        memcpy(&header10, data + info->dataOffset, sizeof(header10));
+        info->dataOffset += sizeof(header10);
+        dxgi = header10.dxgiFormat;
+    }
+
+    if (fourCC == DDS_FOURCC('D', 'X', 'T', '1') || dxgi == DXGI_FORMAT_BC1_UNORM)
+        info->format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    else if (fourCC == DDS_FOURCC('D', 'X', 'T', '5') || dxgi == DXGI_FORMAT_BC3_UNORM)
+        info->format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    else if (dxgi == DXGI_FORMAT_BC7_UNORM)
+        info->format = GL_COMPRESSED_RGBA_BPTC_UNORM;
+    else
+        return 0;
+
+    if (header.width == 0 || header.height == 0 || header.width > DDS_MAX_SIZE || header.height > DDS_MAX_SIZE)
+        return 0;
+
+    info->width = header.width;
+    info->height = header.height;
+    info->blockBytes = block_bytes(info->format);
+
+    // no more levels than the full chain down to 1x1
+    int fullChain = 1;
+    for (int s = info->width > info->height ? info->width : info->height; s > 1; s >>= 1)
+        fullChain++;
+
+    uint32_t levels = (header.flags & DDSD_MIPMAPCOUNT) && header.mipMapCount > 0 ? header.mipMapCount : 1;
+    info->levels = levels < (uint32_t) fullChain ? (int) levels : fullChain;
+
+    // every level must be present, counted against what's left of the file
+    size_t end = info->dataOffset;
+    for (int i = 0; i < info->levels; i++) {
+        size_t levelSize = dds_levelSize(info, i);
+        if (levelSize > size - end) return 0;
+        end += levelSize;
+    }
+
+    return 1;
+}
+
+int dds_writeHeader(FILE *fp, const ddsinfo *info)
+{
+    uint32_t magic = DDS_MAGIC;
+    dds_header header;
+    memset(&header, 0, sizeof(header));
+
+    header.size = sizeof(dds_header);
+    header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+    header.height = info->height;
+    header.width = info->width;
+    header.pitchOrLinearSize = dds_levelSize(info, 0);
+    header.mipMapCount = info->levels;
+    header.ddspf.size = sizeof(dds_pixelformat);
+    header.ddspf.flags = DDPF_FOURCC;
+    header.caps = DDSCAPS_TEXTURE | (info->levels > 1 ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0);
+
+    // bc7 has no legacy fourcc, it needs the dx10 extension header
+    dds_header10 header10 = { DXGI_FORMAT_BC7_UNORM, 3, 0, 1, 0 };
+
+    switch (info->format) {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:  header.ddspf.fourCC = DDS_FOURCC('D', 'X', 'T', '1'); break;
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: header.ddspf.fourCC = DDS_FOURCC('D', 'X', 'T', '5'); break;
+        case GL_COMPRESSED_RGBA_BPTC_UNORM:    header.ddspf.fourCC = DDS_FOURCC('D', 'X', '1', '0'); break;
+        default:
+            fprintf(stderr, "Unsupported dds format 0x%x.\n", info->format);
+            return 0;
+    }
+
+    fwrite(&magic, 4, 1, fp);
+    fwrite(&header, sizeof(header), 1, fp);
+    if (info->format == GL_COMPRESSED_RGBA_BPTC_UNORM)
+        fwrite(&header10, sizeof(header10), 1, fp);
+
+    return !ferror(fp);
+}
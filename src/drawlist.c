@@ -0,0 +1,159 @@
+#include <drawlist.h>
+#include <string.h>
+
+uint64_t drawlist_key(unsigned int pass, GLuint prog, GLuint vao, unsigned int material, float depth)
+{
+    // depth in [0, 1], quantised; callers flip it for back to front passes
+    if (depth < 0.0f) depth = 0.0f;
+    if (depth > 1.0f) depth = 1.0f;
+    uint64_t d = (uint64_t) (depth * 16777215.0f);
+
+    return ((uint64_t) (pass & 0xF) << 60)
+         | ((uint64_t) (prog & 0xFFF) << 48)
+         | ((uint64_t) (vao & 0xFF) << 40)
+         | ((uint64_t) (material & 0xFFFF) << 24)
+         | d;
+}
+
+int drawlist_create(drawlist *list, int maxDraws)
+{
+    list->packets = (drawpacket *) malloc(maxDraws * sizeof(drawpacket));
+    list->keys = (uint64_t *) malloc(maxDraws * sizeof(uint64_t));
+    list->order = (uint32_t *) malloc(maxDraws * sizeof(uint32_t));
+    list->tmpKeys = (uint64_t *) malloc(maxDraws * sizeof(uint64_t));
+    list->tmpOrder = (uint32_t *) malloc(maxDraws * sizeof(uint32_t));
+    list->len = 0;
+    list->cap = maxDraws;
+    list->draws = 0;
+    list->batches = 0;
+
+    return stream_create(&list->commands, GL_DRAW_INDIRECT_BUFFER, maxDraws * sizeof(drawcommand));
+}
+
+void drawlist_begin(drawlist *list)
+{
+    list->len = 0;
+}
+
+int drawlist_push(drawlist *list, const drawpacket *packet)
+{
+    if (list->len == list->cap) {
+        fprintf(stderr, "Draw list full (%d draws).\n", list->cap);
+        return 0;
+    }
+
+    list->packets[list->len] = *packet;
+    list->keys[list->len] = packet->key;
+    list->order[list->len] = list->len;
+    list->len++;
+
+    return 1;
+}
+
+// lsd radix sort of (key, index) pairs, a byte at a time. stable, so equal
+// keys keep their submission order. bytes that are the same in every key
+// are skipped, which with few programs and materials is most of them.
+static void sort(drawlist *list)
+{
+    uint64_t *keys = list->keys, *tmpKeys = list->tmpKeys;
+    uint32_t *order = list->order, *tmpOrder = list->tmpOrder;
+    int n = list->len;
+
+    for (int shift = 0; shift < 64; shift += 8) {
+        unsigned int counts[256] = { 0 };
+        for (int i = 0; i < n; i++)
+            counts[(keys[i] >> shift) & 0xFF]++;
+
+        if (counts[(keys[0] >> shift) & 0xFF] == (unsigned int) n)
+            continue;
+
+        unsigned int sum = 0;
+        for (int i = 0; i < 256; i++) {
+            unsigned int c = counts[i];
+            counts[i] = sum;
+            sum += c;
+        }
+
+        for (int i = 0; i < n; i++) {
+            unsigned int dst = counts[(keys[i] >> shift) & 0xFF]++;
+            tmpKeys[dst] = keys[i];
+            tmpOrder[dst] = order[i];
+        }
+
+        uint64_t *k = keys; keys = tmpKeys; tmpKeys = k;
+        uint32_t *o = order; order = tmpOrder; tmpOrder = o;
+    }
+
+    list->keys = keys;
+    list->tmpKeys = tmpKeys;
+    list->order = order;
+    list->tmpOrder = tmpOrder;
+}
+
+static int compatible(const drawpacket *a, const drawpacket *b)
+{
+    return a->prog == b->prog && a->vao == b->vao && a->texture == b->texture
+        && a->mode == b->mode && a->indexType == b->indexType;
+}
+
+void drawlist_flush(drawlist *list, glstate *gl)
+{
+    list->draws = 0;
+    list->batches = 0;
+
+    if (list->len == 0)
+        return;
+
+    sort(list);
+
+    // write the commands in sorted order, so each run is contiguous
+    stream_begin(&list->commands);
+
+    GLintptr offset;
+    drawcommand *cmds = (drawcommand *) stream_alloc(&list->commands, list->len * sizeof(drawcommand),
+                                                     sizeof(drawcommand), &offset);
+    if (cmds == NULL) {
+        stream_end(&list->commands);
+        return;
+    }
+
+    for (int i = 0; i < list->len; i++)
+        cmds[i] = list->packets[list->order[i]].cmd;
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, list->commands.buffer);
+
+    for (int start = 0; start < list->len; ) {
+        const drawpacket *first = &list->packets[list->order[start]];
+
+        int end = start + 1;
+        while (end < list->len && compatible(first, &list->packets[list->order[end]]))
+            end++;
+
+        state_useProgram(gl, first->prog);
+        state_bindVertexArray(gl, first->vao);
+        if (first->texture != 0)
+            state_bindTexture(gl, 0, first->texture);
+
+        glMultiDrawElementsIndirect(first->mode, first->indexType,
+                                    (void *) (offset + start * sizeof(drawcommand)), end - start, 0);
+
+        list->draws += end - start;
+        list->batches++;
+        start = end;
+    }
+
+    stream_end(&list->commands);
+}
+
+void drawlist_destroy(drawlist *list)
+{
+    stream_destroy(&list->commands);
+
+    free(list->packets);
+    free(list->keys);
+    free(list->order);
+    free(list->tmpKeys);
+    free(list->tmpOrder);
+    list->packets = NULL;
+    list->len = list->cap = 0;
+}
@@ -0,0 +1,88 @@
+#include <gpucull.h>
+
+int gpucull_create(gpucull *gc, glstate *gl, const mesh *m, int capacity)
+{
+    gc->len = 0;
+    gc->capacity = capacity;
+    gc->indexType = m->indexType;
+
+    glCreateBuffers(1, &gc->objects);
+    glNamedBufferStorage(gc->objects, capacity * sizeof(gpuobject), NULL, GL_DYNAMIC_STORAGE_BIT);
+
+    // written by the compute shader only
+    glCreateBuffers(1, &gc->commands);
+    glNamedBufferStorage(gc->commands, capacity * 5 * sizeof(GLuint), NULL, 0);
+
+    glCreateBuffers(1, &gc->visible);
+    glNamedBufferStorage(gc->visible, capacity * sizeof(mat4), NULL, 0);
+
+    glCreateBuffers(1, &gc->count);
+    glNamedBufferStorage(gc->count, 2 * sizeof(GLuint), NULL, GL_DYNAMIC_STORAGE_BIT);
+
+    // same vertex layout as the mesh's own vao, instance matrices from the visible list
+    glGenVertexArrays(1, &gc->vao);
+    state_bindVertexArray(gl, gc->vao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m->VBO);
+    vertex_bind(&m->format);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m->EBO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, gc->visible);
+    for (int i = 0; i < 4; i++) {
+        glVertexAttribPointer(2 + i, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void *) (i * sizeof(vec4)));
+        glEnableVertexAttribArray(2 + i);
+        glVertexAttribDivisor(2 + i, 1);
+    }
+
+    return 1;
+}
+
+void gpucull_upload(gpucull *gc, const gpuobject *objects, int count)
+{
+    if (count > gc->capacity) {
+        fprintf(stderr, "Too many objects for the gpu cull buffers (%d > %d).\n", count, gc->capacity);
+        count = gc->capacity;
+    }
+
+    glNamedBufferSubData(gc->objects, 0, count * sizeof(gpuobject), objects);
+    gc->len = count;
+}
+
+void gpucull_cull(gpucull *gc, glstate *gl, program cull)
+{
+    GLuint counts[2] = { 0, (GLuint) gc->len };
+    glNamedBufferSubData(gc->count, 0, sizeof(counts), counts);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GPUCULL_OBJECT_BINDING, gc->objects);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GPUCULL_COMMAND_BINDING, gc->commands);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GPUCULL_VISIBLE_BINDING, gc->visible);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GPUCULL_COUNT_BINDING, gc->count);
+
+    state_useProgram(gl, cull);
+    glDispatchCompute((gc->len + 63) / 64, 1, 1);
+
+    // the draw reads the commands, the count and the matrices as vertex input
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+void gpucull_draw(gpucull *gc, glstate *gl, program prog, GLuint texture)
+{
+    state_useProgram(gl, prog);
+    state_bindVertexArray(gl, gc->vao);
+    if (texture != 0)
+        state_bindTexture(gl, 0, texture);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, gc->commands);
+    glBindBuffer(GL_PARAMETER_BUFFER, gc->count);
+
+    glMultiDrawElementsIndirectCount(GL_TRIANGLES, gc->indexType, (void *) 0, 0, gc->len, 0);
+}
+
+void gpucull_destroy(gpucull *gc)
+{
+    glDeleteVertexArrays(1, &gc->vao);
+    glDeleteBuffers(1, &gc->objects);
+    glDeleteBuffers(1, &gc->commands);
+    glDeleteBuffers(1, &gc->visible);
+    glDeleteBuffers(1, &gc->count);
+}
@@ -4,14 +4,23 @@
 #include <cglm/cglm.h>
 #include <cglm/io.h>
 
-#include "stb_image.h"
-
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include <unistd.h>
 
+#include "bench.h"
 #include "camera.h"
+#include "drawlist.h"
+#include "gpucull.h"
+#include "mesh.h"
+#include "reflect.h"
+#include "scene.h"
 #include "shader.h"
+#include "state.h"
+#include "stream.h"
+#include "texture.h"
 
 // vertex data
 float vertices[] = {
@@ -62,6 +71,9 @@ float vertices[] = {
 unsigned int window_w = 800;
 unsigned int window_h = 600;
 
+// gl state shadow, every bind and toggle goes through it
+glstate gl;
+
 // camera
 camera cam;
 float fov;
@@ -72,25 +84,80 @@ float deltaTime;
 // cursor
 float curX, curY;
 
+// headless benchmark: render this many frames offscreen, then exit
+int headless = 0;
+int benchFrames = 1000;
+
+// instancing: number of cube copies drawn with a single call
+int instanceCount = 1;
+
+// binary mesh cache to draw instead of the built-in cube
+const char *meshPath = NULL;
+
+// gpu-driven: cull and build the draws in a compute shader instead of on the cpu
+int gpuCull = 0;
+
 // forward-declarations
 void framebuffer_resize_callback(GLFWwindow *window, int w, int h);
 void cursor_callback(GLFWwindow *window, double x, double y);
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
 
 void processInput(GLFWwindow *window);
+void programReady(program prog, int status, void *user);
+void buildInstances(mat4 *models, int count, float time, const mesh *m);
 
-int main()
+int main(int argc, char **argv)
 {
+    /*
+     * Parse arguments
+     */
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--headless") == 0) {
+            headless = 1;
+            if (i + 1 < argc && atoi(argv[i + 1]) > 0)
+                benchFrames = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--instances") == 0 && i + 1 < argc) {
+            instanceCount = atoi(argv[++i]);
+            if (instanceCount < 1) instanceCount = 1;
+        }
+        else if (strcmp(argv[i], "--mesh") == 0 && i + 1 < argc) {
+            meshPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--gpu-cull") == 0) {
+            gpuCull = 1;
+        }
+    }
+
     /*
      * Initialise GLFW/GLAD
      */
 
+    // glfw: with no display, use the null platform and render through OSMesa
+#ifdef GLFW_PLATFORM_NULL
+    if (headless && !getenv("DISPLAY") && !getenv("WAYLAND_DISPLAY")
+            && glfwPlatformSupported(GLFW_PLATFORM_NULL))
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
+
     // glfw: start & set version
-    glfwInit();
+    if (!glfwInit()) {
+        printf("Failed to initialise GLFW.\n");
+        return -1;
+    }
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
+    if (headless) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef GLFW_PLATFORM_NULL
+        if (glfwGetPlatform() == GLFW_PLATFORM_NULL)
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+#endif
+    }
+
     // glfw: create a window
     GLFWwindow *window = glfwCreateWindow(window_w, window_h, "LearnOpenGL", NULL, NULL);
     if (window == NULL)
@@ -100,92 +167,161 @@ int main()
         return -1;
     }
 
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-
     glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_resize_callback);
-    glfwSetCursorPosCallback(window, cursor_callback);
-    glfwSetScrollCallback(window, scroll_callback);
 
-    // glad: load GL functions
-    if (!gladLoadGL()) {
+    if (!headless) {
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        glfwSetFramebufferSizeCallback(window, framebuffer_resize_callback);
+        glfwSetCursorPosCallback(window, cursor_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+    }
+
+    // glad: load GL functions through glfw, so OSMesa contexts work too
+    if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
         fprintf(stderr, "Failed to initialise GLAD.");
         return -1;
     }
 
     /*
-     * Load, generate and bind textures
+     * Load textures in the background, they show a placeholder until uploaded
      */
 
-    int texWidth, texHeight, texChannels;
-    unsigned char *data = stbi_load("texture.jpg", &texWidth, &texHeight, &texChannels, 0);
-
-    if (!data) {
-        printf("Failed to load texture from file.");
+    texloader loader;
+    if (!texture_loaderCreate(&loader, 0)) {
+        glfwTerminate();
+        return -1;
     }
 
-    unsigned int texture;
-    glGenTextures(1, &texture);
-
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, texWidth, texHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    stbi_image_free(data);
+    // prefer the pre-compressed mip chain from 'make textures'
+    const char *diffusePath = access("texture.dds", R_OK) == 0 ? "texture.dds" : "texture.jpg";
+    texture *diffuse = texture_load(&loader, diffusePath, 1);
 
     /*
-     * Generate and compile shaders
+     * Compile shaders and link them into a program, reusing the cached binary from the last run
+     * when the sources and driver haven't changed. Saving a shader file rebuilds it in place.
      */
 
-    shader vertexShader, fragmentShader;
-    shader_loadFile("./shader/vertex.glsl", GL_VERTEX_SHADER, &vertexShader);
-    shader_loadFile("./shader/fragment.glsl", GL_FRAGMENT_SHADER, &fragmentShader);
-
-    /*
-     * Create a shader program and attach shaders.
-     * Delete the shaders when it's done, we don't need them anymore
-     */
+    shaderreloader shaders;
+    if (!shader_reloaderCreate(&shaders))
+        fprintf(stderr, "Shader hot reload is off.\n");
 
+    // uniforms are looked up by hashed name in the program's reflection, rebuilt with it
     program shaderProgram;
-    shader_createProgram(&shaderProgram, 2, vertexShader, fragmentShader);
+    reflection shaderInfo = { 0 };
+    uniform textureIndex = reflect_id("textureIndex");
+    uniform octNormals = reflect_id("octNormals");
 
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    if (!shader_reloaderAdd(&shaders, &shaderProgram, programReady, &shaderInfo, 2,
+            "./shader/vertex.glsl", GL_VERTEX_SHADER,
+            loader.bindless ? "./shader/fragment_bindless.glsl" : "./shader/fragment.glsl", GL_FRAGMENT_SHADER)) {
+        glfwTerminate();
+        return -1;
+    }
 
     /*
-     * Set up uniform values.
+     * Set up the per-frame uniform block, shared by every program.
      */
 
-    uniform u_time = glGetUniformLocation(shaderProgram, "time");
-    uniform u_model = glGetUniformLocation(shaderProgram, "model");
-    uniform u_view = glGetUniformLocation(shaderProgram, "view");
-    uniform u_projection = glGetUniformLocation(shaderProgram, "projection");
-
-    mat4 model, view, projection;
+    stream frameStream;
+    if (!stream_create(&frameStream, GL_UNIFORM_BUFFER, sizeof(framedata))) {
+        glfwTerminate();
+        return -1;
+    }
 
     /*
      * Set up vertex data, configure vertex attrs.
      */
 
+    state_create(&gl);
+
     // vertex array
     unsigned int VAO;
     glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
+    state_bindVertexArray(&gl, VAO);
+
+    // vertex & index buffers: map a mesh cache, or weld the raw cube into an indexed mesh.
+    // a cache that doesn't validate falls back to the cube
+    mesh model;
+    int meshStatus = meshPath && mesh_load(&model, meshPath);
+    if (!meshStatus) {
+        if (meshPath) fprintf(stderr, "Drawing the built-in cube instead.\n");
+        meshStatus = mesh_create(&model, vertices, sizeof(vertices) / (5 * sizeof(float)), 5);
+    }
+
+    if (!meshStatus) {
+        glfwTerminate();
+        return -1;
+    }
+
+    // vertex attributes: snorm16 positions, unorm16 texture coords (a cache keeps its own)
+    mesh_upload(&model, VERTEXFORMAT_COMPACT);
+
+    // instance buffer: one model matrix per cube, advanced once per instance.
+    // rewritten every frame through a persistently mapped ring buffer.
+    stream instanceStream;
+    if (!stream_create(&instanceStream, GL_ARRAY_BUFFER, instanceCount * sizeof(mat4))) {
+        glfwTerminate();
+        return -1;
+    }
 
-    // vertex buffer
-    unsigned int VBO;
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    // a mat4 attribute takes four consecutive locations, one per column.
+    // each frame's matrices are picked with the draw's base instance.
+    for (int i = 0; i < 4; i++) {
+        glVertexAttribPointer(2 + i, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void *) (i * sizeof(vec4)));
+        glEnableVertexAttribArray(2 + i);
+        glVertexAttribDivisor(2 + i, 1);
+    }
+
+    // render queue: packets are sorted by key and merged into multi-draws
+    drawlist drawList;
+    if (!drawlist_create(&drawList, 1024)) {
+        glfwTerminate();
+        return -1;
+    }
+
+    // cpu culling: the instances live in a bvh, refitted as they move every frame
+    float meshMin[3], meshMax[3];
+    mesh_bounds(&model, meshMin, meshMax);
 
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    mat4 *instanceModels = (mat4 *) malloc(instanceCount * sizeof(mat4));
+    uint32_t *visibleInstances = (uint32_t *) malloc(instanceCount * sizeof(uint32_t));
+    buildInstances(instanceModels, instanceCount, 0.0f, &model);
 
+    scene instanceScene;
+    if (!scene_create(&instanceScene, instanceCount)) {
+        glfwTerminate();
+        return -1;
+    }
+    for (int i = 0; i < instanceCount; i++)
+        scene_add(&instanceScene, instanceModels[i], meshMin, meshMax);
+    if (!scene_build(&instanceScene)) {
+        glfwTerminate();
+        return -1;
+    }
 
-    // vertex attributes
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *) 0);                     // vertex coords
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *) (3 * sizeof(float)));   // texture coords
+    // gpu-driven: the objects are placed once, everything per frame happens on the gpu
+    gpucull culler;
+    program cullProgram = 0;
 
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
+    if (gpuCull) {
+        if (!shader_reloaderAdd(&shaders, &cullProgram, NULL, NULL, 1, "./shader/cull.glsl", GL_COMPUTE_SHADER)
+                || !gpucull_create(&culler, &gl, &model, instanceCount)) {
+            glfwTerminate();
+            return -1;
+        }
+
+        gpuobject *objects = (gpuobject *) calloc(instanceCount, sizeof(gpuobject));
+
+        for (int i = 0; i < instanceCount; i++) {
+            glm_mat4_copy(instanceModels[i], objects[i].model);
+            glm_vec4_copy((vec4) { meshMin[0], meshMin[1], meshMin[2], 1.0f }, objects[i].boundsMin);
+            glm_vec4_copy((vec4) { meshMax[0], meshMax[1], meshMax[2], 1.0f }, objects[i].boundsMax);
+            objects[i].indexCount = model.indexCount;
+        }
+
+        gpucull_upload(&culler, objects, instanceCount);
+        free(objects);
+    }
 
     /*
      * Setup camera
@@ -194,17 +330,51 @@ int main()
     cam = cam_create((vec3) { 0, 0, 0 }, (vec3) { 0, 0, 0 });
     fov = 45;
 
+    /*
+     * Headless: render into an offscreen framebuffer
+     */
+
+    unsigned int FBO = 0, colorRBO = 0, depthRBO = 0;
+    bench frameBench = bench_create(benchFrames);
+
+    if (headless) {
+        glGenRenderbuffers(1, &colorRBO);
+        glBindRenderbuffer(GL_RENDERBUFFER, colorRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, window_w, window_h);
+
+        glGenRenderbuffers(1, &depthRBO);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, window_w, window_h);
+
+        glGenFramebuffers(1, &FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRBO);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthRBO);
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            fprintf(stderr, "Failed to create offscreen framebuffer.\n");
+            glfwTerminate();
+            return -1;
+        }
+
+        state_viewport(&gl, 0, 0, window_w, window_h);
+    }
+
     /*
      * Process the event-loop
      */
 
     glClearColor(0.6f, 0.6f, 0.8f, 1.0f);
-    glEnable(GL_DEPTH_TEST);
+    state_depthTest(&gl, 1);
 
-    while (!glfwWindowShouldClose(window))
+    while (headless ? frameBench.len < benchFrames : !glfwWindowShouldClose(window))
     {
+        double frameStart = glfwGetTime();
+        unsigned long frameDraws = 0;
+
         // process user input
-        processInput(window);
+        if (!headless)
+            processInput(window);
 
         // work out frame time
         float lastFrame, currentTime;
@@ -212,34 +382,117 @@ int main()
         deltaTime = currentTime - lastFrame;
         lastFrame = currentTime;
 
+        // upload any textures the workers have finished decoding
+        texture_update(&loader);
+
+        // swap in any shaders that were edited and rebuilt
+        shader_reloaderUpdate(&shaders);
+
+        // place every instance and refit the bvh around the new bounds
+        if (!gpuCull) {
+            buildInstances(instanceModels, instanceCount, currentTime, &model);
+            for (int i = 0; i < instanceCount; i++)
+                scene_setTransform(&instanceScene, i, instanceModels[i]);
+            scene_refit(&instanceScene);
+        }
+
         // render the frame
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glUseProgram(shaderProgram);
+        // bindless: the texture is picked from the handle buffer, nothing is bound per draw
+        if (loader.bindless)
+            reflect_setUint(&shaderInfo, textureIndex, diffuse->slot);
+
+        // tell the vertex shader how the mesh stores its normals
+        reflect_setUint(&shaderInfo, octNormals, model.format.normal == GL_SHORT);
 
-        glm_mat4_identity(model);
-        glm_mat4_identity(projection);
+        // frame data: written once, read by every program this frame
+        stream_begin(&frameStream);
 
-        // model
+        GLintptr frameOffset;
+        framedata *frame = (framedata *) stream_alloc(&frameStream, sizeof(framedata), 256, &frameOffset);
 
         // view
         cam_update(&cam);
 
-        printf("\033c");
-        printf("pos: %.1f, %.1f, %.1f\n", cam.pos[X], cam.pos[Y], cam.pos[Z]);
-        printf("pitch: %.1f, roll: %.1f, yaw: %.1f\n", cam.eulers[PITCH], cam.eulers[ROLL], cam.eulers[YAW]);
-        printf("fov: %.1f\n", fov);
-
-        // projection
+        if (!headless) {
+            printf("\033c");
+            printf("pos: %.1f, %.1f, %.1f\n", cam.pos[X], cam.pos[Y], cam.pos[Z]);
+            printf("pitch: %.1f, roll: %.1f, yaw: %.1f\n", cam.eulers[PITCH], cam.eulers[ROLL], cam.eulers[YAW]);
+            printf("fov: %.1f\n", fov);
+
+            // whatever the crosshair is on
+            float distance;
+            int target = scene_pick(&instanceScene, cam.pos, cam.dir, &distance);
+            if (target >= 0)
+                printf("target: instance %d, %.1f away\n", target, distance);
+        }
+
+        // projection, built locally: the mapped frame data is write-only
+        mat4 projection, viewProjection;
         glm_perspective(glm_rad(fov), (float) window_w / (float) window_h, 0.1, 100.0, projection);
-
-        glUniformMatrix4fv(u_model, 1, GL_FALSE, (float *) model);
-        glUniformMatrix4fv(u_view, 1, GL_FALSE, (float *) cam.view);
-        glUniformMatrix4fv(u_projection, 1, GL_FALSE, (float *) projection);
-
-        glUniform1f(u_time, currentTime);
-
-        glDrawArrays(GL_TRIANGLES, 0, 36);
+        glm_mat4_mul(projection, cam.view, viewProjection);
+
+        glm_mat4_copy(cam.view, frame->view);
+        glm_mat4_copy(projection, frame->projection);
+        glm_mat4_copy(viewProjection, frame->viewProjection);
+        glm_vec4_copy((vec4) { 0, 0, window_w, window_h }, frame->viewport);
+        frame->time = currentTime;
+
+        glBindBufferRange(GL_UNIFORM_BUFFER, SHADER_FRAMEDATA_BINDING, frameStream.buffer, frameOffset, sizeof(framedata));
+
+        // cpu path: cull against this frame's frustum, then write only the
+        // visible transforms straight into mapped memory
+        GLintptr instanceOffset = 0;
+        int visibleCount = 0;
+
+        if (!gpuCull) {
+            frustum view;
+            cam_frustum(viewProjection, &view);
+            visibleCount = scene_cull(&instanceScene, &view, visibleInstances);
+
+            stream_begin(&instanceStream);
+
+            mat4 *models = (mat4 *) stream_alloc(&instanceStream, instanceCount * sizeof(mat4), sizeof(mat4), &instanceOffset);
+            for (int i = 0; i < visibleCount; i++)
+                glm_mat4_copy(instanceModels[visibleInstances[i]], models[i]);
+        }
+
+        GLuint material = loader.bindless ? 0 : diffuse->id;
+
+        if (gpuCull) {
+            gpucull_cull(&culler, &gl, cullProgram);
+            gpucull_draw(&culler, &gl, shaderProgram, material);
+            frameDraws++;
+        } else {
+            drawlist_begin(&drawList);
+
+            drawpacket packet = {
+                .key = drawlist_key(0, shaderProgram, VAO, material, 0.0f),
+                .prog = shaderProgram,
+                .vao = VAO,
+                .texture = material,
+                .mode = GL_TRIANGLES,
+                .indexType = model.indexType,
+                .cmd = { model.indexCount, visibleCount, 0, 0, instanceOffset / sizeof(mat4) }
+            };
+            if (visibleCount > 0)
+                drawlist_push(&drawList, &packet);
+
+            drawlist_flush(&drawList, &gl);
+            frameDraws += drawList.batches;
+
+            stream_end(&instanceStream);
+        }
+
+        stream_end(&frameStream);
+
+        // headless: wait for the gpu so the frame time covers the whole frame
+        if (headless) {
+            glFinish();
+            bench_frame(&frameBench, glfwGetTime() - frameStart, frameDraws);
+            continue;
+        }
 
         // glfw: swap buffers, poll events
         glfwSwapBuffers(window);
@@ -250,13 +503,38 @@ int main()
      * Exit cleanly
      */
 
+    if (headless) {
+        bench_report(&frameBench, stdout);
+        fprintf(stderr, "state: %lu calls, %lu elided\n", gl.calls, gl.elided);
+
+        glDeleteFramebuffers(1, &FBO);
+        glDeleteRenderbuffers(1, &colorRBO);
+        glDeleteRenderbuffers(1, &depthRBO);
+    }
+    bench_destroy(&frameBench);
+    if (gpuCull)
+        gpucull_destroy(&culler);
+    drawlist_destroy(&drawList);
+    scene_destroy(&instanceScene);
+    free(visibleInstances);
+    free(instanceModels);
+    stream_destroy(&instanceStream);
+    stream_destroy(&frameStream);
+    mesh_destroy(&model);
+    texture_loaderDestroy(&loader);
+    shader_reloaderDestroy(&shaders);
+    reflect_destroy(&shaderInfo);
+    glDeleteProgram(shaderProgram);
+    if (cullProgram)
+        glDeleteProgram(cullProgram);
+
     glfwTerminate();
     return 0;
 }
 
 void framebuffer_resize_callback(GLFWwindow *window, int w, int h)
 {
-    glViewport(0, 0, w, h);
+    state_viewport(&gl, 0, 0, w, h);
     window_w = w;
     window_h = h;
 }
@@ -289,6 +567,14 @@ void scroll_callback(GLFWwindow *window, double xoffset, double yoffset)
     if (fov > 45.0) fov = 45.0;
 }
 
+void programReady(program prog, int status, void *user)
+{
+    // uniforms don't carry over to a rebuilt program, start from a fresh table
+    reflection *info = (reflection *) user;
+    reflect_destroy(info);
+    reflect_create(info, prog);
+}
+
 void processInput(GLFWwindow *window)
 {
     #define key(KEYNAME) if (glfwGetKey(window, KEYNAME) == GLFW_PRESS)
@@ -340,3 +626,30 @@ void processInput(GLFWwindow *window)
         cam_lookat(&cam, (vec3) { 0, 0, 0 });
     }
 }
+
+void buildInstances(mat4 *models, int count, float time, const mesh *m)
+{
+    // lay the cubes out on a grid centred on the origin
+    int side = (int) ceil(cbrt((double) count));
+    float spacing = 1.5f;
+    float offset = (side - 1) * spacing * 0.5f;
+
+    for (int i = 0; i < count; i++) {
+        vec3 pos = {
+            (i % side) * spacing - offset,
+            (i / side % side) * spacing - offset,
+            (i / (side * side)) * spacing - offset
+        };
+
+        glm_mat4_identity(models[i]);
+        glm_translate(models[i], pos);
+
+        // spin everything but the lone default cube
+        if (count > 1)
+            glm_rotate(models[i], time + i * 0.1f, (vec3) { 0.5f, 1.0f, 0.0f });
+
+        // undo the mesh's position quantisation
+        glm_translate(models[i], (float *) m->posOffset);
+        glm_scale(models[i], (float *) m->posScale);
+    }
+}
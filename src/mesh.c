@@ -0,0 +1,512 @@
+#include <mesh.h>
+#include <math.h>
+#include <limits.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+size_t mesh_indexSize(const mesh *m)
+{
+    return m->indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+/*
+ * Vertex welding
+ */
+
+static uint32_t hash_vertex(const float *v, int stride)
+{
+    // fnv-1a over the raw bytes, so only bit-identical vertices weld
+    const unsigned char *bytes = (const unsigned char *) v;
+    uint32_t h = 2166136261u;
+
+    for (size_t i = 0; i < stride * sizeof(float); i++) {
+        h ^= bytes[i];
+        h *= 16777619u;
+    }
+
+    return h;
+}
+
+static int weld(const float *in, int count, int stride, float *out, uint32_t *remap)
+{
+    // open-addressed table of output vertex indices, power of two sized
+    int size = 1;
+    while (size < count * 2) size <<= 1;
+
+    int *table = (int *) malloc(size * sizeof(int));
+    memset(table, -1, size * sizeof(int));
+
+    int unique = 0;
+    for (int i = 0; i < count; i++) {
+        const float *v = in + i * stride;
+        uint32_t slot = hash_vertex(v, stride) & (size - 1);
+
+        while (table[slot] != -1 && memcmp(out + table[slot] * stride, v, stride * sizeof(float)) != 0)
+            slot = (slot + 1) & (size - 1);
+
+        if (table[slot] == -1) {
+            memcpy(out + unique * stride, v, stride * sizeof(float));
+            table[slot] = unique++;
+        }
+
+        remap[i] = table[slot];
+    }
+
+    free(table);
+    return unique;
+}
+
+/*
+ * Post-transform cache optimisation (Forsyth, "Linear-Speed Vertex Cache
+ * Optimisation"): greedily emit the triangle whose vertices score best,
+ * favouring vertices already in a simulated LRU cache and vertices with
+ * few remaining triangles.
+ */
+
+#define CACHE_SIZE 32
+
+static float vertex_score(int cachePos, int remaining)
+{
+    if (remaining == 0) return -1.0f;
+
+    float score = 0.0f;
+    if (cachePos >= 0) {
+        if (cachePos < 3) {
+            // the last triangle's vertices get a fixed score, so we don't
+            // just ping-pong around the same edge
+            score = 0.75f;
+        } else {
+            float scaler = 1.0f / (CACHE_SIZE - 3);
+            score = powf(1.0f - (cachePos - 3) * scaler, 1.5f);
+        }
+    }
+
+    // boost vertices with few triangles left, to finish them off
+    return score + 2.0f * powf((float) remaining, -0.5f);
+}
+
+static void optimize_cache(uint32_t *indices, int indexCount, int vertexCount)
+{
+    int triCount = indexCount / 3;
+
+    // vertex -> triangle adjacency, packed
+    int *remaining = (int *) calloc(vertexCount, sizeof(int));
+    int *offsets = (int *) malloc((vertexCount + 1) * sizeof(int));
+    int *adjacency = (int *) malloc(indexCount * sizeof(int));
+    int *fill = (int *) calloc(vertexCount, sizeof(int));
+
+    for (int i = 0; i < indexCount; i++)
+        remaining[indices[i]]++;
+
+    offsets[0] = 0;
+    for (int v = 0; v < vertexCount; v++)
+        offsets[v + 1] = offsets[v] + remaining[v];
+
+    for (int i = 0; i < indexCount; i++) {
+        uint32_t v = indices[i];
+        adjacency[offsets[v] + fill[v]++] = i / 3;
+    }
+
+    int *cachePos = (int *) malloc(vertexCount * sizeof(int));
+    float *vScore = (float *) malloc(vertexCount * sizeof(float));
+    for (int v = 0; v < vertexCount; v++) {
+        cachePos[v] = -1;
+        vScore[v] = vertex_score(-1, remaining[v]);
+    }
+
+    float *tScore = (float *) malloc(triCount * sizeof(float));
+    char *added = (char *) calloc(triCount, 1);
+    for (int t = 0; t < triCount; t++)
+        tScore[t] = vScore[indices[t * 3]] + vScore[indices[t * 3 + 1]] + vScore[indices[t * 3 + 2]];
+
+    uint32_t *out = (uint32_t *) malloc(indexCount * sizeof(uint32_t));
+    int cache[CACHE_SIZE + 3], cacheLen = 0;
+
+    // the first triangle is the best one overall
+    int best = 0;
+    for (int t = 1; t < triCount; t++)
+        if (tScore[t] > tScore[best]) best = t;
+
+    int scan = 0;
+    for (int emitted = 0; emitted < triCount; emitted++) {
+        if (best < 0) {
+            // nothing in the cache touches an open triangle, take the next one
+            while (added[scan]) scan++;
+            best = scan;
+        }
+
+        added[best] = 1;
+        uint32_t *tri = indices + best * 3;
+        memcpy(out + emitted * 3, tri, 3 * sizeof(uint32_t));
+
+        // drop the triangle from its vertices' adjacency
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = tri[k];
+            int *adj = adjacency + offsets[v];
+
+            for (int j = 0; j < remaining[v]; j++) {
+                if (adj[j] == best) {
+                    adj[j] = adj[remaining[v] - 1];
+                    break;
+                }
+            }
+            remaining[v]--;
+        }
+
+        // move the triangle's vertices to the front of the lru cache
+        int next[CACHE_SIZE + 3], nextLen = 0;
+        for (int k = 0; k < 3; k++)
+            next[nextLen++] = tri[k];
+        for (int j = 0; j < cacheLen; j++)
+            if (cache[j] != (int) tri[0] && cache[j] != (int) tri[1] && cache[j] != (int) tri[2])
+                next[nextLen++] = cache[j];
+
+        // rescore everything that was or is in the cache, evicting the tail
+        for (int j = 0; j < nextLen; j++) {
+            int v = next[j];
+            cachePos[v] = j < CACHE_SIZE ? j : -1;
+            vScore[v] = vertex_score(cachePos[v], remaining[v]);
+        }
+
+        cacheLen = nextLen < CACHE_SIZE ? nextLen : CACHE_SIZE;
+        memcpy(cache, next, cacheLen * sizeof(int));
+
+        // pick the best open triangle touching the cache
+        best = -1;
+        float bestScore = -1.0f;
+        for (int j = 0; j < cacheLen; j++) {
+            int v = cache[j];
+            for (int a = 0; a < remaining[v]; a++) {
+                int t = adjacency[offsets[v] + a];
+                tScore[t] = vScore[indices[t * 3]] + vScore[indices[t * 3 + 1]] + vScore[indices[t * 3 + 2]];
+                if (tScore[t] > bestScore) {
+                    bestScore = tScore[t];
+                    best = t;
+                }
+            }
+        }
+    }
+
+    memcpy(indices, out, indexCount * sizeof(uint32_t));
+
+    free(out);
+    free(added);
+    free(tScore);
+    free(vScore);
+    free(cachePos);
+    free(fill);
+    free(adjacency);
+    free(offsets);
+    free(remaining);
+}
+
+/*
+ * Vertex fetch optimisation: renumber vertices in order of first use,
+ * so the index buffer walks the vertex buffer mostly forwards.
+ */
+
+static void optimize_fetch(uint32_t *indices, int indexCount, float *vertices, int vertexCount, int stride)
+{
+    int *remap = (int *) malloc(vertexCount * sizeof(int));
+    memset(remap, -1, vertexCount * sizeof(int));
+
+    float *sorted = (float *) malloc(vertexCount * stride * sizeof(float));
+    int next = 0;
+
+    for (int i = 0; i < indexCount; i++) {
+        uint32_t v = indices[i];
+        if (remap[v] == -1) {
+            memcpy(sorted + next * stride, vertices + v * stride, stride * sizeof(float));
+            remap[v] = next++;
+        }
+        indices[i] = remap[v];
+    }
+
+    memcpy(vertices, sorted, next * stride * sizeof(float));
+
+    free(sorted);
+    free(remap);
+}
+
+int mesh_create(mesh *m, const float *vertices, int vertexCount, int stride)
+{
+    if (vertexCount <= 0 || vertexCount % 3 != 0) {
+        fprintf(stderr, "Mesh is not a triangle list (%d vertices).\n", vertexCount);
+        return 0;
+    }
+
+    float *welded = (float *) malloc(vertexCount * stride * sizeof(float));
+    uint32_t *indices = (uint32_t *) malloc(vertexCount * sizeof(uint32_t));
+
+    int unique = weld(vertices, vertexCount, stride, welded, indices);
+
+    optimize_cache(indices, vertexCount, unique);
+    optimize_fetch(indices, vertexCount, welded, unique, stride);
+
+    m->vertices = (float *) realloc(welded, unique * stride * sizeof(float));
+    m->vertexCount = unique;
+    m->indexCount = vertexCount;
+    m->stride = stride;
+    m->packed = NULL;
+    m->mapping = NULL;
+    m->mappingSize = 0;
+    m->VBO = m->EBO = 0;
+    m->format = VERTEXFORMAT_FLOAT;
+
+    for (int c = 0; c < 3; c++) {
+        m->posScale[c] = 1.0f;
+        m->posOffset[c] = 0.0f;
+    }
+
+    // 16-bit indices whenever every vertex fits
+    if (unique <= 0xFFFF) {
+        uint16_t *small = (uint16_t *) malloc(vertexCount * sizeof(uint16_t));
+        for (int i = 0; i < vertexCount; i++)
+            small[i] = (uint16_t) indices[i];
+        free(indices);
+
+        m->indices = small;
+        m->indexType = GL_UNSIGNED_SHORT;
+    } else {
+        m->indices = indices;
+        m->indexType = GL_UNSIGNED_INT;
+    }
+
+    return 1;
+}
+
+void mesh_pack(mesh *m, vertexformat format)
+{
+    if (vertex_srcStride(&format) > m->stride) {
+        fprintf(stderr, "Mesh has no normals, packing without them.\n");
+        format.normal = GL_NONE;
+    }
+
+    // the format may widen texcoords that don't fit
+    free(m->packed);
+    m->packed = malloc((size_t) m->vertexCount * vertex_stride(&format));
+    vertex_pack(&format, m->vertices, m->vertexCount, m->stride, m->packed, m->posScale, m->posOffset);
+    m->format = format;
+}
+
+void mesh_upload(mesh *m, vertexformat format)
+{
+    // the element buffer binding and attributes are recorded in the currently bound vao
+    if (m->packed == NULL)
+        mesh_pack(m, format);
+
+    glGenBuffers(1, &m->VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, m->VBO);
+    glBufferStorage(GL_ARRAY_BUFFER, (size_t) m->vertexCount * vertex_stride(&m->format), m->packed, 0);
+
+    vertex_bind(&m->format);
+
+    glGenBuffers(1, &m->EBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m->EBO);
+    glBufferStorage(GL_ELEMENT_ARRAY_BUFFER, (size_t) m->indexCount * mesh_indexSize(m), m->indices, 0);
+}
+
+// bounds of the stored positions, the space posScale/posOffset map from
+// (callers fold those into the model matrix). packed positions are decoded
+// from their format, so half and snorm16 bounds are the real ones.
+void mesh_bounds(const mesh *m, float min[3], float max[3])
+{
+    const unsigned char *src = m->packed ? (const unsigned char *) m->packed : (const unsigned char *) m->vertices;
+    size_t stride = m->packed ? (size_t) vertex_stride(&m->format) : m->stride * sizeof(float);
+
+    for (int c = 0; c < 3; c++) {
+        min[c] = m->vertexCount ? 1e30f : 0.0f;
+        max[c] = m->vertexCount ? -1e30f : 0.0f;
+    }
+
+    for (int i = 0; i < m->vertexCount; i++) {
+        float pos[3];
+        if (m->packed)
+            vertex_position(&m->format, src + i * stride, pos);
+        else
+            memcpy(pos, src + i * stride, sizeof(pos));
+
+        for (int c = 0; c < 3; c++) {
+            if (pos[c] < min[c]) min[c] = pos[c];
+            if (pos[c] > max[c]) max[c] = pos[c];
+        }
+    }
+}
+
+/*
+ * Binary cache
+ */
+
+static uint64_t align_up(uint64_t x)
+{
+    return (x + MESH_FILE_ALIGN - 1) / MESH_FILE_ALIGN * MESH_FILE_ALIGN;
+}
+
+int mesh_save(const mesh *m, const char *path)
+{
+    if (m->packed == NULL) {
+        fprintf(stderr, "Mesh must be packed before saving.\n");
+        return 0;
+    }
+
+    size_t vertexSize = (size_t) m->vertexCount * vertex_stride(&m->format);
+    size_t indexSize = (size_t) m->indexCount * mesh_indexSize(m);
+
+    meshfile header = { 0 };
+    header.magic = MESH_MAGIC;
+    header.version = MESH_VERSION;
+    header.vertexCount = m->vertexCount;
+    header.indexCount = m->indexCount;
+    header.indexType = m->indexType;
+    header.position = m->format.position;
+    header.texcoord = m->format.texcoord;
+    header.normal = m->format.normal;
+    memcpy(header.posScale, m->posScale, sizeof(header.posScale));
+    memcpy(header.posOffset, m->posOffset, sizeof(header.posOffset));
+    header.vertexOffset = align_up(sizeof(meshfile));
+    header.indexOffset = align_up(header.vertexOffset + vertexSize);
+
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        perror("Failed to open mesh file.");
+        return 0;
+    }
+
+    // blobs are padded so each starts on an aligned offset
+    static const unsigned char zeros[MESH_FILE_ALIGN] = { 0 };
+
+    fwrite(&header, sizeof(header), 1, fp);
+    fwrite(zeros, 1, header.vertexOffset - sizeof(header), fp);
+    fwrite(m->packed, 1, vertexSize, fp);
+    fwrite(zeros, 1, header.indexOffset - header.vertexOffset - vertexSize, fp);
+    fwrite(m->indices, 1, indexSize, fp);
+
+    int status = !ferror(fp);
+    if (fclose(fp) != 0) status = 0;
+
+    if (!status)
+        fprintf(stderr, "Failed to write mesh file %s.\n", path);
+
+    return status;
+}
+
+// a cache's header fields, checked before anything in the file is touched
+static int valid_header(const meshfile *header, size_t fileSize)
+{
+    if (header->magic != MESH_MAGIC || header->version != MESH_VERSION)
+        return 0;
+
+    if (header->vertexCount > INT_MAX || header->indexCount > INT_MAX)
+        return 0;
+
+    if (header->indexType != GL_UNSIGNED_SHORT && header->indexType != GL_UNSIGNED_INT)
+        return 0;
+
+    if (header->position != GL_FLOAT && header->position != GL_HALF_FLOAT && header->position != GL_SHORT)
+        return 0;
+    if (header->texcoord != GL_FLOAT && header->texcoord != GL_HALF_FLOAT && header->texcoord != GL_UNSIGNED_SHORT)
+        return 0;
+    if (header->normal != GL_NONE && header->normal != GL_FLOAT && header->normal != GL_SHORT)
+        return 0;
+
+    // sizes can't overflow (counts are below 2^31, strides small), offsets
+    // are compared without adding to them
+    vertexformat format = { header->position, header->texcoord, header->normal };
+    uint64_t vertexSize = (uint64_t) header->vertexCount * vertex_stride(&format);
+    uint64_t indexSize = (uint64_t) header->indexCount * (header->indexType == GL_UNSIGNED_SHORT ? 2 : 4);
+
+    return header->vertexOffset <= fileSize && vertexSize <= fileSize - header->vertexOffset
+        && header->indexOffset <= fileSize && indexSize <= fileSize - header->indexOffset
+        && header->indexOffset % (header->indexType == GL_UNSIGNED_SHORT ? 2 : 4) == 0;
+}
+
+// every index must name a vertex, or the gpu fetches past the buffer
+static int valid_indices(const meshfile *header, const void *indices)
+{
+    if (header->indexType == GL_UNSIGNED_SHORT) {
+        const uint16_t *idx = (const uint16_t *) indices;
+        for (uint32_t i = 0; i < header->indexCount; i++)
+            if (idx[i] >= header->vertexCount) return 0;
+    } else {
+        const uint32_t *idx = (const uint32_t *) indices;
+        for (uint32_t i = 0; i < header->indexCount; i++)
+            if (idx[i] >= header->vertexCount) return 0;
+    }
+    return 1;
+}
+
+int mesh_load(mesh *m, const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("Failed to open mesh file.");
+        return 0;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(meshfile)) {
+        fprintf(stderr, "Mesh file %s is truncated.\n", path);
+        close(fd);
+        return 0;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED) {
+        perror("Failed to map mesh file.");
+        return 0;
+    }
+
+    // the whole file goes straight to the gpu, read it ahead
+    madvise(map, st.st_size, MADV_WILLNEED | MADV_SEQUENTIAL);
+
+    const meshfile *header = (const meshfile *) map;
+    vertexformat format = { header->position, header->texcoord, header->normal };
+
+    if (!valid_header(header, st.st_size) || !valid_indices(header, (unsigned char *) map + header->indexOffset)) {
+        fprintf(stderr, "Mesh file %s is invalid or from another version.\n", path);
+        munmap(map, st.st_size);
+        return 0;
+    }
+
+    // point straight into the mapping, nothing is parsed or copied
+    m->vertices = NULL;
+    m->packed = (unsigned char *) map + header->vertexOffset;
+    m->indices = (unsigned char *) map + header->indexOffset;
+    m->vertexCount = header->vertexCount;
+    m->indexCount = header->indexCount;
+    m->stride = 0;
+    m->indexType = header->indexType;
+    m->format = format;
+    memcpy(m->posScale, header->posScale, sizeof(m->posScale));
+    memcpy(m->posOffset, header->posOffset, sizeof(m->posOffset));
+    m->mapping = map;
+    m->mappingSize = st.st_size;
+    m->VBO = m->EBO = 0;
+
+    return 1;
+}
+
+void mesh_destroy(mesh *m)
+{
+    if (m->VBO) glDeleteBuffers(1, &m->VBO);
+    if (m->EBO) glDeleteBuffers(1, &m->EBO);
+
+    if (m->mapping) {
+        munmap(m->mapping, m->mappingSize);
+    } else {
+        free(m->vertices);
+        free(m->packed);
+        free(m->indices);
+    }
+
+    m->vertices = NULL;
+    m->packed = NULL;
+    m->indices = NULL;
+    m->mapping = NULL;
+    m->VBO = m->EBO = 0;
+}
@@ -0,0 +1,309 @@
+#include <mip.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MIP_X86 1
+#endif
+
+// linear light is kept in 14 bits, so four samples still sum in 16
+#define MIP_LINEAR_MAX 16383
+
+// rows of the next level per parallel task
+#define MIP_BAND_ROWS 32
+
+// [0] srgb colour, [1] alpha, which is scaled but not curved
+static uint16_t toLinear[2][256];
+static uint8_t fromLinear[2][MIP_LINEAR_MAX + 1];
+static pthread_once_t tablesOnce = PTHREAD_ONCE_INIT;
+
+static void build_tables(void)
+{
+    for (int i = 0; i < 256; i++) {
+        float v = i / 255.0f;
+        float lin = v <= 0.04045f ? v / 12.92f : powf((v + 0.055f) / 1.055f, 2.4f);
+        toLinear[0][i] = (uint16_t) (lin * MIP_LINEAR_MAX + 0.5f);
+        toLinear[1][i] = (uint16_t) ((i * MIP_LINEAR_MAX + 127) / 255);
+    }
+
+    for (int i = 0; i <= MIP_LINEAR_MAX; i++) {
+        float lin = (float) i / MIP_LINEAR_MAX;
+        float v = lin <= 0.0031308f ? lin * 12.92f : 1.055f * powf(lin, 1.0f / 2.4f) - 0.055f;
+        fromLinear[0][i] = (uint8_t) (v * 255.0f + 0.5f);
+        fromLinear[1][i] = (uint8_t) ((i * 255 + MIP_LINEAR_MAX / 2) / MIP_LINEAR_MAX);
+    }
+}
+
+int mip_levelCount(int width, int height)
+{
+    int levels = 1;
+    for (int s = width > height ? width : height; s > 1; s >>= 1)
+        levels++;
+    return levels;
+}
+
+size_t mip_chainSize(int width, int height, int channels)
+{
+    size_t size = 0;
+    for (int i = 0; i < mip_levelCount(width, height); i++) {
+        int w = width >> i, h = height >> i;
+        size += (size_t) (w > 1 ? w : 1) * (h > 1 ? h : 1) * channels;
+    }
+    return size;
+}
+
+/*
+ * Box filter rows for even sizes: each output texel is the rounded mean of
+ * a 2x2 block, the row or column repeats where the source is one texel thick
+ */
+
+#ifdef MIP_X86
+
+// x and y hold 16 consecutive 16-bit channel values of a row, returns the
+// 8 sums of horizontally adjacent pixels among them
+static __m128i pair_sums(__m128i x, __m128i y, int channels)
+{
+    if (channels == 4)
+        return _mm_add_epi16(_mm_unpacklo_epi64(x, y), _mm_unpackhi_epi64(x, y));
+
+    if (channels == 2) {
+        __m128 a = _mm_castsi128_ps(x), b = _mm_castsi128_ps(y);
+        return _mm_add_epi16(_mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))),
+                             _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))));
+    }
+
+    // one channel: add within 32-bit lanes and pack back down. packs is
+    // signed, so the sums are moved into its range and back
+    __m128i low = _mm_set1_epi32(0xffff), bias = _mm_set1_epi32(0x8000);
+    __m128i sx = _mm_add_epi32(_mm_and_si128(x, low), _mm_srli_epi32(x, 16));
+    __m128i sy = _mm_add_epi32(_mm_and_si128(y, low), _mm_srli_epi32(y, 16));
+    __m128i packed = _mm_packs_epi32(_mm_sub_epi32(sx, bias), _mm_sub_epi32(sy, bias));
+    return _mm_add_epi16(packed, _mm_set1_epi16((short) 0x8000));
+}
+
+#endif
+
+static void box_row8(const uint8_t *r0, const uint8_t *r1, uint8_t *out, int w, int dw, int channels)
+{
+    int x = 0;
+
+#ifdef MIP_X86
+    // 16 source bytes of each row make 8 output bytes
+    if (channels != 3) {
+        __m128i zero = _mm_setzero_si128(), two = _mm_set1_epi16(2);
+        int step = 8 / channels;
+
+        for (; x + step <= dw; x += step) {
+            __m128i a = _mm_loadu_si128((const __m128i *) (r0 + x * 2 * channels));
+            __m128i b = _mm_loadu_si128((const __m128i *) (r1 + x * 2 * channels));
+            __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+            __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+            __m128i avg = _mm_srli_epi16(_mm_add_epi16(pair_sums(lo, hi, channels), two), 2);
+            _mm_storel_epi64((__m128i *) (out + x * channels), _mm_packus_epi16(avg, avg));
+        }
+    }
+#endif
+
+    for (; x < dw; x++) {
+        int x0 = x * 2, x1 = x * 2 + 1 < w ? x * 2 + 1 : w - 1;
+        for (int c = 0; c < channels; c++) {
+            int sum = r0[x0 * channels + c] + r0[x1 * channels + c] + r1[x0 * channels + c] + r1[x1 * channels + c];
+            out[x * channels + c] = (uint8_t) ((sum + 2) >> 2);
+        }
+    }
+}
+
+static void box_row16(const uint16_t *r0, const uint16_t *r1, uint16_t *out, int w, int dw, int channels)
+{
+    int x = 0;
+
+#ifdef MIP_X86
+    // 16 source values of each row make 8 output values
+    if (channels != 3) {
+        __m128i two = _mm_set1_epi16(2);
+        int step = 8 / channels;
+
+        for (; x + step <= dw; x += step) {
+            const uint16_t *a = r0 + x * 2 * channels, *b = r1 + x * 2 * channels;
+            __m128i lo = _mm_add_epi16(_mm_loadu_si128((const __m128i *) a), _mm_loadu_si128((const __m128i *) b));
+            __m128i hi = _mm_add_epi16(_mm_loadu_si128((const __m128i *) (a + 8)), _mm_loadu_si128((const __m128i *) (b + 8)));
+            __m128i avg = _mm_srli_epi16(_mm_add_epi16(pair_sums(lo, hi, channels), two), 2);
+            _mm_storeu_si128((__m128i *) (out + x * channels), avg);
+        }
+    }
+#endif
+
+    for (; x < dw; x++) {
+        int x0 = x * 2, x1 = x * 2 + 1 < w ? x * 2 + 1 : w - 1;
+        for (int c = 0; c < channels; c++) {
+            int sum = r0[x0 * channels + c] + r0[x1 * channels + c] + r1[x0 * channels + c] + r1[x1 * channels + c];
+            out[x * channels + c] = (uint16_t) ((sum + 2) >> 2);
+        }
+    }
+}
+
+/*
+ * Levels
+ */
+
+typedef struct {
+    const uint8_t *src;
+    uint8_t *dst;
+    int w, h, dw, dh;
+    int channels, srgb;
+} miplevel;
+
+// weights of the source texels from 2 * i on that make output texel i along
+// an axis of n. odd n > 1 take 3 taps, weighted by how much of each source
+// texel the output covers, so the last row or column is not dropped
+static int axis_weights(int i, int n, float weights[3])
+{
+    if (n == 1) {
+        weights[0] = 1.0f;
+        return 1;
+    }
+
+    if (n % 2 == 0) {
+        weights[0] = weights[1] = 0.5f;
+        return 2;
+    }
+
+    int d = n / 2;
+    weights[0] = (float) (d - i) / n;
+    weights[1] = (float) d / n;
+    weights[2] = (float) (i + 1) / n;
+    return 3;
+}
+
+// rows of a level with an odd side: separable, through a float row
+static void filter_rows(const miplevel *m, int first, int last)
+{
+    int c = m->channels;
+    size_t srcRow = (size_t) m->w * c, dstRow = (size_t) m->dw * c;
+    float *acc = (float *) malloc(srcRow * sizeof(float));
+
+    int alpha = c == 2 || c == 4 ? c - 1 : -1;
+
+    for (int y = first; y < last; y++) {
+        float wy[3];
+        int ny = axis_weights(y, m->h, wy);
+
+        for (size_t i = 0; i < srcRow; i++)
+            acc[i] = 0.0f;
+
+        for (int t = 0; t < ny; t++) {
+            const uint8_t *s = m->src + (size_t) (y * 2 + t) * srcRow;
+            for (size_t i = 0; i < srcRow; i += c) {
+                for (int k = 0; k < c; k++) {
+                    float v = m->srgb ? toLinear[k == alpha][s[i + k]] : s[i + k];
+                    acc[i + k] += wy[t] * v;
+                }
+            }
+        }
+
+        uint8_t *d = m->dst + y * dstRow;
+        for (int x = 0; x < m->dw; x++) {
+            float wx[3];
+            int nx = axis_weights(x, m->w, wx);
+
+            for (int k = 0; k < c; k++) {
+                float v = 0.0f;
+                for (int t = 0; t < nx; t++)
+                    v += wx[t] * acc[(size_t) (x * 2 + t) * c + k];
+
+                int q = (int) (v + 0.5f);
+                d[x * c + k] = m->srgb ? fromLinear[k == alpha][q] : (uint8_t) q;
+            }
+        }
+    }
+
+    free(acc);
+}
+
+static void downsample_rows(void *ctx, int band)
+{
+    const miplevel *m = (const miplevel *) ctx;
+    int c = m->channels;
+    int first = band * MIP_BAND_ROWS;
+    int last = first + MIP_BAND_ROWS < m->dh ? first + MIP_BAND_ROWS : m->dh;
+    size_t srcRow = (size_t) m->w * c, dstRow = (size_t) m->dw * c;
+
+    if ((m->w > 1 && m->w % 2) || (m->h > 1 && m->h % 2)) {
+        filter_rows(m, first, last);
+        return;
+    }
+
+    if (!m->srgb) {
+        for (int y = first; y < last; y++) {
+            int y0 = y * 2, y1 = y * 2 + 1 < m->h ? y * 2 + 1 : m->h - 1;
+            box_row8(m->src + y0 * srcRow, m->src + y1 * srcRow, m->dst + y * dstRow, m->w, m->dw, c);
+        }
+        return;
+    }
+
+    // through linear light: decode both source rows, average, encode again
+    uint16_t *l0 = (uint16_t *) malloc((srcRow * 2 + dstRow) * sizeof(uint16_t));
+    uint16_t *l1 = l0 + srcRow, *avg = l1 + srcRow;
+
+    int alpha = c == 2 || c == 4 ? c - 1 : -1;
+    const uint16_t *decode[4];
+    const uint8_t *encode[4];
+    for (int k = 0; k < c; k++) {
+        decode[k] = toLinear[k == alpha];
+        encode[k] = fromLinear[k == alpha];
+    }
+
+    for (int y = first; y < last; y++) {
+        int y0 = y * 2, y1 = y * 2 + 1 < m->h ? y * 2 + 1 : m->h - 1;
+        const uint8_t *s0 = m->src + y0 * srcRow, *s1 = m->src + y1 * srcRow;
+
+        for (size_t i = 0; i < srcRow; i += c) {
+            for (int k = 0; k < c; k++) {
+                l0[i + k] = decode[k][s0[i + k]];
+                l1[i + k] = decode[k][s1[i + k]];
+            }
+        }
+
+        box_row16(l0, l1, avg, m->w, m->dw, c);
+
+        uint8_t *d = m->dst + y * dstRow;
+        for (size_t i = 0; i < dstRow; i += c) {
+            for (int k = 0; k < c; k++)
+                d[i + k] = encode[k][avg[i + k]];
+        }
+    }
+
+    free(l0);
+}
+
+void mip_generate(pool *p, unsigned char *chain, int width, int height, int channels, int srgb)
+{
+    if (srgb)
+        pthread_once(&tablesOnce, build_tables);
+
+    // each level is built from the one before, straight after it in the chain
+    const unsigned char *src = chain;
+    int w = width, h = height;
+
+    while (w > 1 || h > 1) {
+        miplevel m = {
+            src, (uint8_t *) src + (size_t) w * h * channels,
+            w, h, w > 1 ? w / 2 : 1, h > 1 ? h / 2 : 1,
+            channels, srgb
+        };
+
+        int bands = (m.dh + MIP_BAND_ROWS - 1) / MIP_BAND_ROWS;
+        if (p != NULL) {
+            pool_parallelFor(p, downsample_rows, &m, bands);
+        } else {
+            for (int i = 0; i < bands; i++)
+                downsample_rows(&m, i);
+        }
+
+        src = m.dst;
+        w = m.dw;
+        h = m.dh;
+    }
+}
@@ -0,0 +1,188 @@
+#include <pool.h>
+#include <unistd.h>
+#include <stdatomic.h>
+
+// shared by the caller and its helper jobs; freed by whoever leaves last
+typedef struct {
+    pool_task fn;
+    void *ctx;
+    int count;
+    atomic_int next, done, refs;
+    pthread_mutex_t lock;
+    pthread_cond_t finished;
+} parallel;
+
+static void *worker(void *arg)
+{
+    pool *p = (pool *) arg;
+
+    pthread_mutex_lock(&p->lock);
+    for (;;) {
+        while (p->head == NULL && !p->quit)
+            pthread_cond_wait(&p->work, &p->lock);
+
+        if (p->head == NULL && p->quit)
+            break;
+
+        pool_job *job = p->head;
+        p->head = job->next;
+        if (p->head == NULL) p->tail = NULL;
+
+        // run the job without holding the lock
+        pthread_mutex_unlock(&p->lock);
+        job->fn(job->arg);
+        free(job);
+        pthread_mutex_lock(&p->lock);
+
+        if (--p->pending == 0)
+            pthread_cond_broadcast(&p->idle);
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    return NULL;
+}
+
+int pool_cpuCount(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int) n : 1;
+}
+
+int pool_create(pool *p, int threads)
+{
+    if (threads < 1) threads = pool_cpuCount();
+
+    p->threads = (pthread_t *) malloc(threads * sizeof(pthread_t));
+    p->threadCount = 0;
+    p->head = p->tail = NULL;
+    p->pending = 0;
+    p->quit = 0;
+
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->work, NULL);
+    pthread_cond_init(&p->idle, NULL);
+
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&p->threads[i], NULL, worker, p) != 0) {
+            fprintf(stderr, "Failed to start worker thread %d.\n", i);
+            break;
+        }
+        p->threadCount++;
+    }
+
+    if (p->threadCount == 0) {
+        pool_destroy(p);
+        return 0;
+    }
+
+    return 1;
+}
+
+void pool_submit(pool *p, pool_fn fn, void *arg)
+{
+    pool_job *job = (pool_job *) malloc(sizeof(pool_job));
+    job->fn = fn;
+    job->arg = arg;
+    job->next = NULL;
+
+    pthread_mutex_lock(&p->lock);
+    if (p->tail) p->tail->next = job;
+    else         p->head = job;
+    p->tail = job;
+    p->pending++;
+    pthread_cond_signal(&p->work);
+    pthread_mutex_unlock(&p->lock);
+}
+
+void pool_wait(pool *p)
+{
+    pthread_mutex_lock(&p->lock);
+    while (p->pending > 0)
+        pthread_cond_wait(&p->idle, &p->lock);
+    pthread_mutex_unlock(&p->lock);
+}
+
+static void parallel_run(parallel *par)
+{
+    int i;
+    while ((i = atomic_fetch_add(&par->next, 1)) < par->count) {
+        par->fn(par->ctx, i);
+
+        if (atomic_fetch_add(&par->done, 1) + 1 == par->count) {
+            pthread_mutex_lock(&par->lock);
+            pthread_cond_broadcast(&par->finished);
+            pthread_mutex_unlock(&par->lock);
+        }
+    }
+}
+
+static void parallel_release(parallel *par)
+{
+    if (atomic_fetch_sub(&par->refs, 1) != 1) return;
+
+    pthread_mutex_destroy(&par->lock);
+    pthread_cond_destroy(&par->finished);
+    free(par);
+}
+
+static void parallel_helper(void *arg)
+{
+    parallel *par = (parallel *) arg;
+    parallel_run(par);
+    parallel_release(par);
+}
+
+void pool_parallelFor(pool *p, pool_task fn, void *ctx, int count)
+{
+    int helpers = count - 1 < p->threadCount ? count - 1 : p->threadCount;
+
+    if (helpers < 1) {
+        for (int i = 0; i < count; i++)
+            fn(ctx, i);
+        return;
+    }
+
+    parallel *par = (parallel *) malloc(sizeof(parallel));
+    par->fn = fn;
+    par->ctx = ctx;
+    par->count = count;
+    atomic_init(&par->next, 0);
+    atomic_init(&par->done, 0);
+    atomic_init(&par->refs, helpers + 1);
+    pthread_mutex_init(&par->lock, NULL);
+    pthread_cond_init(&par->finished, NULL);
+
+    for (int i = 0; i < helpers; i++)
+        pool_submit(p, parallel_helper, par);
+
+    // work alongside the helpers; late ones find nothing left and leave.
+    // only tasks already claimed by a running helper are waited for.
+    parallel_run(par);
+
+    pthread_mutex_lock(&par->lock);
+    while (atomic_load(&par->done) < count)
+        pthread_cond_wait(&par->finished, &par->lock);
+    pthread_mutex_unlock(&par->lock);
+
+    parallel_release(par);
+}
+
+void pool_destroy(pool *p)
+{
+    // finish queued work, then let the workers exit
+    pthread_mutex_lock(&p->lock);
+    p->quit = 1;
+    pthread_cond_broadcast(&p->work);
+    pthread_mutex_unlock(&p->lock);
+
+    for (int i = 0; i < p->threadCount; i++)
+        pthread_join(p->threads[i], NULL);
+
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->work);
+    pthread_cond_destroy(&p->idle);
+
+    free(p->threads);
+    p->threads = NULL;
+    p->threadCount = 0;
+}
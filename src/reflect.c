@@ -0,0 +1,245 @@
+#include <reflect.h>
+#include <string.h>
+
+uniform reflect_id(const char *name)
+{
+    // fnv-1a, 32-bit. "name[0]" hashes like "name" so arrays are found by their base name
+    uint32_t h = 2166136261u;
+    size_t len = strlen(name);
+    if (len > 3 && strcmp(name + len - 3, "[0]") == 0)
+        len -= 3;
+
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char) name[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static char *resource_name(program prog, GLenum interface, GLuint index, GLint length)
+{
+    char *name = (char *) malloc(length > 0 ? length : 1);
+    name[0] = '\0';
+    glGetProgramResourceName(prog, interface, index, length, NULL, name);
+    return name;
+}
+
+static void reflect_uniforms(reflection *r)
+{
+    GLint count = 0;
+    glGetProgramInterfaceiv(r->prog, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count);
+
+    r->uniforms = (reflectuniform *) calloc(count > 0 ? count : 1, sizeof(reflectuniform));
+    r->uniformCount = 0;
+
+    // table at least twice the uniform count, as a power of two
+    int slots = 8;
+    while (slots < count * 2)
+        slots *= 2;
+    r->slots = (int *) malloc(slots * sizeof(int));
+    r->slotMask = slots - 1;
+    for (int i = 0; i < slots; i++)
+        r->slots[i] = -1;
+
+    const GLenum props[] = { GL_NAME_LENGTH, GL_TYPE, GL_LOCATION, GL_ARRAY_SIZE, GL_BLOCK_INDEX };
+    for (GLint i = 0; i < count; i++) {
+        GLint values[5];
+        glGetProgramResourceiv(r->prog, GL_UNIFORM, i, 5, props, 5, NULL, values);
+
+        // block members have no location, they're set through their buffer
+        if (values[4] != -1 || values[2] == -1)
+            continue;
+
+        char *name = resource_name(r->prog, GL_UNIFORM, i, values[0]);
+        uniform id = reflect_id(name);
+
+        if (reflect_uniform(r, id) != NULL) {
+            fprintf(stderr, "Uniform name hash collision on %s.\n", name);
+            free(name);
+            continue;
+        }
+        free(name);
+
+        reflectuniform *u = &r->uniforms[r->uniformCount];
+        u->id = id;
+        u->type = values[1];
+        u->location = values[2];
+        u->size = values[3];
+        u->valid = 0;
+
+        int slot = id & r->slotMask;
+        while (r->slots[slot] != -1)
+            slot = (slot + 1) & r->slotMask;
+        r->slots[slot] = r->uniformCount++;
+    }
+}
+
+static void reflect_attributes(reflection *r)
+{
+    GLint count = 0;
+    glGetProgramInterfaceiv(r->prog, GL_PROGRAM_INPUT, GL_ACTIVE_RESOURCES, &count);
+
+    r->attributes = (reflectattribute *) calloc(count > 0 ? count : 1, sizeof(reflectattribute));
+    r->attributeCount = 0;
+
+    const GLenum props[] = { GL_NAME_LENGTH, GL_TYPE, GL_LOCATION };
+    for (GLint i = 0; i < count; i++) {
+        GLint values[3];
+        glGetProgramResourceiv(r->prog, GL_PROGRAM_INPUT, i, 3, props, 3, NULL, values);
+
+        reflectattribute *a = &r->attributes[r->attributeCount++];
+        a->name = resource_name(r->prog, GL_PROGRAM_INPUT, i, values[0]);
+        a->id = reflect_id(a->name);
+        a->type = values[1];
+        a->location = values[2];
+    }
+}
+
+static void reflect_blocks(reflection *r)
+{
+    const GLenum interfaces[] = { GL_UNIFORM_BLOCK, GL_SHADER_STORAGE_BLOCK };
+    GLint counts[2] = { 0, 0 };
+    for (int i = 0; i < 2; i++)
+        glGetProgramInterfaceiv(r->prog, interfaces[i], GL_ACTIVE_RESOURCES, &counts[i]);
+
+    r->blocks = (reflectblock *) calloc(counts[0] + counts[1] + 1, sizeof(reflectblock));
+    r->blockCount = 0;
+
+    const GLenum props[] = { GL_NAME_LENGTH, GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE };
+    for (int i = 0; i < 2; i++) {
+        for (GLint j = 0; j < counts[i]; j++) {
+            GLint values[3];
+            glGetProgramResourceiv(r->prog, interfaces[i], j, 3, props, 3, NULL, values);
+
+            reflectblock *b = &r->blocks[r->blockCount++];
+            b->name = resource_name(r->prog, interfaces[i], j, values[0]);
+            b->id = reflect_id(b->name);
+            b->interface = interfaces[i];
+            b->index = j;
+            b->binding = values[1];
+            b->size = values[2];
+        }
+    }
+}
+
+int reflect_create(reflection *r, program prog)
+{
+    memset(r, 0, sizeof(reflection));
+    r->prog = prog;
+
+    if (prog == 0)
+        return 0;
+
+    reflect_uniforms(r);
+    reflect_attributes(r);
+    reflect_blocks(r);
+
+    return 1;
+}
+
+void reflect_destroy(reflection *r)
+{
+    for (int i = 0; i < r->attributeCount; i++)
+        free(r->attributes[i].name);
+    for (int i = 0; i < r->blockCount; i++)
+        free(r->blocks[i].name);
+
+    free(r->uniforms);
+    free(r->slots);
+    free(r->attributes);
+    free(r->blocks);
+    memset(r, 0, sizeof(reflection));
+}
+
+reflectuniform *reflect_uniform(reflection *r, uniform id)
+{
+    if (r->slots == NULL)
+        return NULL;
+
+    for (int slot = id & r->slotMask; r->slots[slot] != -1; slot = (slot + 1) & r->slotMask) {
+        reflectuniform *u = &r->uniforms[r->slots[slot]];
+        if (u->id == id)
+            return u;
+    }
+    return NULL;
+}
+
+reflectattribute *reflect_attribute(reflection *r, const char *name)
+{
+    uniform id = reflect_id(name);
+    for (int i = 0; i < r->attributeCount; i++) {
+        if (r->attributes[i].id == id)
+            return &r->attributes[i];
+    }
+    return NULL;
+}
+
+reflectblock *reflect_block(reflection *r, const char *name)
+{
+    uniform id = reflect_id(name);
+    for (int i = 0; i < r->blockCount; i++) {
+        if (r->blocks[i].id == id)
+            return &r->blocks[i];
+    }
+    return NULL;
+}
+
+// returns the uniform if the value differs from what was last uploaded
+static reflectuniform *changed(reflection *r, uniform id, const void *value, size_t size)
+{
+    reflectuniform *u = reflect_uniform(r, id);
+    if (u == NULL)
+        return NULL;
+
+    if (u->valid && memcmp(u->value, value, size) == 0) {
+        r->skipped++;
+        return NULL;
+    }
+
+    memcpy(u->value, value, size);
+    u->valid = 1;
+    r->uploads++;
+    return u;
+}
+
+void reflect_setInt(reflection *r, uniform id, int value)
+{
+    reflectuniform *u = changed(r, id, &value, sizeof(value));
+    if (u) glProgramUniform1i(r->prog, u->location, value);
+}
+
+void reflect_setUint(reflection *r, uniform id, unsigned int value)
+{
+    reflectuniform *u = changed(r, id, &value, sizeof(value));
+    if (u) glProgramUniform1ui(r->prog, u->location, value);
+}
+
+void reflect_setFloat(reflection *r, uniform id, float value)
+{
+    reflectuniform *u = changed(r, id, &value, sizeof(value));
+    if (u) glProgramUniform1f(r->prog, u->location, value);
+}
+
+void reflect_setVec2(reflection *r, uniform id, vec2 value)
+{
+    reflectuniform *u = changed(r, id, value, sizeof(vec2));
+    if (u) glProgramUniform2fv(r->prog, u->location, 1, value);
+}
+
+void reflect_setVec3(reflection *r, uniform id, vec3 value)
+{
+    reflectuniform *u = changed(r, id, value, sizeof(vec3));
+    if (u) glProgramUniform3fv(r->prog, u->location, 1, value);
+}
+
+void reflect_setVec4(reflection *r, uniform id, vec4 value)
+{
+    reflectuniform *u = changed(r, id, value, sizeof(vec4));
+    if (u) glProgramUniform4fv(r->prog, u->location, 1, value);
+}
+
+void reflect_setMat4(reflection *r, uniform id, mat4 value)
+{
+    reflectuniform *u = changed(r, id, value, sizeof(mat4));
+    if (u) glProgramUniformMatrix4fv(r->prog, u->location, 1, GL_FALSE, (const float *) value);
+}
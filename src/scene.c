@@ -0,0 +1,473 @@
+#include <scene.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+#define SCENE_STACK 128
+
+// deepest inner node: its pending siblings plus its two children still fit
+// the traversal stack. nodes this deep become leaves, whatever their size
+#define SCENE_MAX_DEPTH (SCENE_STACK - 2)
+
+// sah costs: a node visit against one box of a leaf, which goes 8 at a time
+#define COST_TRAVERSE 1.0f
+#define COST_BOX      0.25f
+
+int scene_create(scene *s, int capacity)
+{
+    memset(s, 0, sizeof(scene));
+    if (capacity < 1) capacity = 1;
+
+    s->cap = capacity;
+    s->transforms = (mat4 *) malloc(capacity * sizeof(mat4));
+    s->localBounds = (float (*)[6]) malloc(capacity * sizeof(*s->localBounds));
+    s->worldBounds = (float (*)[6]) malloc(capacity * sizeof(*s->worldBounds));
+
+    return s->transforms && s->localBounds && s->worldBounds;
+}
+
+// world box around the transformed local box
+static void world_box(mat4 m, const float local[6], float out[6])
+{
+    for (int r = 0; r < 3; r++) {
+        float center = m[3][r], extent = 0.0f;
+        for (int k = 0; k < 3; k++) {
+            float c = 0.5f * (local[k] + local[3 + k]);
+            float e = 0.5f * (local[3 + k] - local[k]);
+            center += m[k][r] * c;
+            extent += fabsf(m[k][r]) * e;
+        }
+        out[r] = center - extent;
+        out[3 + r] = center + extent;
+    }
+}
+
+static void set_slot(scene *s, int slot, const float box[6])
+{
+    float center[3], extent[3];
+    for (int k = 0; k < 3; k++) {
+        center[k] = 0.5f * (box[k] + box[3 + k]);
+        extent[k] = 0.5f * (box[3 + k] - box[k]);
+    }
+    cull_set(&s->bounds, slot, center, extent);
+}
+
+static void grow(float box[6], const float other[6])
+{
+    for (int k = 0; k < 3; k++) {
+        if (other[k] < box[k]) box[k] = other[k];
+        if (other[3 + k] > box[3 + k]) box[3 + k] = other[3 + k];
+    }
+}
+
+static void empty(float box[6])
+{
+    box[0] = box[1] = box[2] = FLT_MAX;
+    box[3] = box[4] = box[5] = -FLT_MAX;
+}
+
+static float area(const float box[6])
+{
+    float dx = box[3] - box[0], dy = box[4] - box[1], dz = box[5] - box[2];
+    if (dx < 0.0f || dy < 0.0f || dz < 0.0f)
+        return 0.0f;
+    return dx * dy + dy * dz + dz * dx;
+}
+
+int scene_add(scene *s, mat4 transform, const float localMin[3], const float localMax[3])
+{
+    if (s->len == s->cap) {
+        s->cap *= 2;
+        s->transforms = (mat4 *) realloc(s->transforms, s->cap * sizeof(mat4));
+        s->localBounds = (float (*)[6]) realloc(s->localBounds, s->cap * sizeof(*s->localBounds));
+        s->worldBounds = (float (*)[6]) realloc(s->worldBounds, s->cap * sizeof(*s->worldBounds));
+    }
+
+    int object = s->len++;
+    glm_mat4_copy(transform, s->transforms[object]);
+    memcpy(s->localBounds[object], localMin, 3 * sizeof(float));
+    memcpy(s->localBounds[object] + 3, localMax, 3 * sizeof(float));
+    world_box(transform, s->localBounds[object], s->worldBounds[object]);
+
+    // new objects need a new tree
+    s->built = 0;
+    return object;
+}
+
+void scene_setTransform(scene *s, int object, mat4 transform)
+{
+    glm_mat4_copy(transform, s->transforms[object]);
+    world_box(transform, s->localBounds[object], s->worldBounds[object]);
+
+    if (!s->built)
+        return;
+
+    set_slot(s, s->slots[object], s->worldBounds[object]);
+
+    // flag the path to the root, stopping where another object already did
+    for (int node = s->leaves[object]; node >= 0 && !s->dirty[node]; node = s->parents[node])
+        s->dirty[node] = 1;
+}
+
+/*
+ * SAH build
+ */
+
+static void node_bounds(scene *s, bvhnode *node)
+{
+    float box[6];
+    empty(box);
+
+    if (node->count > 0) {
+        for (int i = node->first; i < node->first + node->count; i++)
+            grow(box, s->worldBounds[s->order[i]]);
+    } else {
+        float child[6];
+        for (int c = 0; c < 2; c++) {
+            const bvhnode *n = &s->nodes[node->first + c];
+            memcpy(child, n->min, 3 * sizeof(float));
+            memcpy(child + 3, n->max, 3 * sizeof(float));
+            grow(box, child);
+        }
+    }
+
+    memcpy(node->min, box, 3 * sizeof(float));
+    memcpy(node->max, box + 3, 3 * sizeof(float));
+}
+
+static float centroid(const float box[6], int axis)
+{
+    return 0.5f * (box[axis] + box[3 + axis]);
+}
+
+static void build_node(scene *s, int index, int first, int count, int depth)
+{
+    bvhnode *node = &s->nodes[index];
+    node->first = first;
+    node->count = count;
+    node_bounds(s, node);
+
+    if (count <= 1 || depth >= SCENE_MAX_DEPTH)
+        return;
+
+    // centroid bounds pick the bins, the split is never outside them
+    float cbox[6];
+    empty(cbox);
+    for (int i = first; i < first + count; i++) {
+        const float *b = s->worldBounds[s->order[i]];
+        float c[6] = { centroid(b, 0), centroid(b, 1), centroid(b, 2), centroid(b, 0), centroid(b, 1), centroid(b, 2) };
+        grow(cbox, c);
+    }
+
+    float nodeBox[6] = { node->min[0], node->min[1], node->min[2], node->max[0], node->max[1], node->max[2] };
+    float bestCost = FLT_MAX;
+    int bestAxis = -1, bestBin = 0;
+
+    for (int axis = 0; axis < 3; axis++) {
+        float lo = cbox[axis], extent = cbox[3 + axis] - lo;
+        if (extent <= 0.0f)
+            continue;
+
+        int binCount[SCENE_BINS] = { 0 };
+        float binBox[SCENE_BINS][6];
+        for (int b = 0; b < SCENE_BINS; b++)
+            empty(binBox[b]);
+
+        float scale = SCENE_BINS / extent;
+        for (int i = first; i < first + count; i++) {
+            const float *box = s->worldBounds[s->order[i]];
+            int b = (int) ((centroid(box, axis) - lo) * scale);
+            if (b >= SCENE_BINS) b = SCENE_BINS - 1;
+            binCount[b]++;
+            grow(binBox[b], box);
+        }
+
+        // sweep from the right, then from the left evaluating each plane
+        float rightArea[SCENE_BINS];
+        int rightCount[SCENE_BINS];
+        float acc[6];
+        empty(acc);
+        int n = 0;
+        for (int b = SCENE_BINS - 1; b > 0; b--) {
+            grow(acc, binBox[b]);
+            n += binCount[b];
+            rightArea[b] = area(acc);
+            rightCount[b] = n;
+        }
+
+        empty(acc);
+        n = 0;
+        for (int b = 0; b < SCENE_BINS - 1; b++) {
+            grow(acc, binBox[b]);
+            n += binCount[b];
+            if (n == 0 || rightCount[b + 1] == 0)
+                continue;
+
+            float cost = area(acc) * n + rightArea[b + 1] * rightCount[b + 1];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBin = b + 1;
+            }
+        }
+    }
+
+    // small nodes stay leaves unless splitting is cheaper than testing them all
+    float leafCost = COST_BOX * count * area(nodeBox);
+    bestCost = COST_TRAVERSE * area(nodeBox) + COST_BOX * bestCost;
+    if (bestAxis < 0 || (count <= SCENE_LEAF_SIZE && bestCost >= leafCost))
+        return;
+
+    float lo = cbox[bestAxis];
+    float scale = SCENE_BINS / (cbox[3 + bestAxis] - lo);
+    int mid = first;
+    for (int i = first; i < first + count; i++) {
+        int b = (int) ((centroid(s->worldBounds[s->order[i]], bestAxis) - lo) * scale);
+        if (b >= SCENE_BINS) b = SCENE_BINS - 1;
+        if (b < bestBin) {
+            uint32_t t = s->order[i];
+            s->order[i] = s->order[mid];
+            s->order[mid] = t;
+            mid++;
+        }
+    }
+
+    int left = s->nodeCount;
+    s->nodeCount += 2;
+    s->parents[left] = s->parents[left + 1] = index;
+
+    node = &s->nodes[index];
+    node->first = left;
+    node->count = 0;
+
+    build_node(s, left, first, mid - first, depth + 1);
+    build_node(s, left + 1, mid, first + count - mid, depth + 1);
+}
+
+// realloc that keeps the old block on failure
+static int resize(void **ptr, size_t size)
+{
+    void *p = realloc(*ptr, size);
+    if (p == NULL)
+        return 0;
+    *ptr = p;
+    return 1;
+}
+
+int scene_build(scene *s)
+{
+    s->built = 0;
+
+    int maxNodes = 2 * (s->len > 0 ? s->len : 1);
+    if (!resize((void **) &s->nodes, maxNodes * sizeof(bvhnode))
+            || !resize((void **) &s->parents, maxNodes * sizeof(int))
+            || !resize((void **) &s->dirty, maxNodes)
+            || !resize((void **) &s->order, s->len * sizeof(uint32_t) + 1)
+            || !resize((void **) &s->slots, s->len * sizeof(int) + 1)
+            || !resize((void **) &s->leaves, s->len * sizeof(int) + 1)) {
+        fprintf(stderr, "Failed to allocate the scene BVH.\n");
+        return 0;
+    }
+
+    for (int i = 0; i < s->len; i++)
+        s->order[i] = i;
+    memset(s->dirty, 0, maxNodes);
+
+    s->nodeCount = 1;
+    s->parents[0] = -1;
+    build_node(s, 0, 0, s->len, 0);
+
+    // leaf order for the cull slices, and the way back from each object
+    if (s->bounds.cx)
+        cull_destroy(&s->bounds);
+    if (!cull_create(&s->bounds, s->len))
+        return 0;
+
+    for (int n = 0; n < s->nodeCount; n++) {
+        const bvhnode *node = &s->nodes[n];
+        for (int i = node->first; node->count > 0 && i < node->first + node->count; i++) {
+            s->slots[s->order[i]] = i;
+            s->leaves[s->order[i]] = n;
+            set_slot(s, i, s->worldBounds[s->order[i]]);
+        }
+    }
+
+    s->built = 1;
+    return 1;
+}
+
+int scene_refit(scene *s)
+{
+    if (!s->built)
+        return scene_build(s);
+
+    // children always come after their parent, so walk backwards
+    for (int n = s->nodeCount - 1; n >= 0; n--) {
+        if (s->dirty[n]) {
+            node_bounds(s, &s->nodes[n]);
+            s->dirty[n] = 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Queries
+ */
+
+// -1 outside, 0 intersecting, 1 inside
+static int classify(const bvhnode *node, const frustum *f)
+{
+    int result = 1;
+    for (int p = 0; p < 6; p++) {
+        const float *n = f->planes[p];
+        float d = n[3], r = 0.0f;
+        for (int k = 0; k < 3; k++) {
+            d += n[k] * 0.5f * (node->min[k] + node->max[k]);
+            r += fabsf(n[k]) * 0.5f * (node->max[k] - node->min[k]);
+        }
+        if (d + r < 0.0f)
+            return -1;
+        if (d - r < 0.0f)
+            result = 0;
+    }
+    return result;
+}
+
+// writes the indices of the objects at least partly inside, returns how many
+int scene_cull(scene *s, const frustum *f, uint32_t *visible)
+{
+    if (!s->built && !scene_build(s))
+        return 0;
+    if (s->len == 0)
+        return 0;
+
+    int stack[SCENE_STACK];
+    unsigned char inside[SCENE_STACK];
+    int top = 0, count = 0;
+
+    stack[top] = 0;
+    inside[top++] = 0;
+
+    while (top > 0) {
+        top--;
+        const bvhnode *node = &s->nodes[stack[top]];
+        int in = inside[top];
+
+        if (!in) {
+            int c = classify(node, f);
+            if (c < 0)
+                continue;
+            in = c > 0;
+        }
+
+        if (node->count > 0) {
+            if (in) {
+                for (int i = node->first; i < node->first + node->count; i++)
+                    visible[count++] = s->order[i];
+            } else {
+                int n = cull_frustumRange(&s->bounds, f, node->first, node->count, visible + count);
+                for (int i = 0; i < n; i++)
+                    visible[count + i] = s->order[visible[count + i]];
+                count += n;
+            }
+            continue;
+        }
+
+        // a subtree fully inside is listed without further tests
+        if (top + 2 > SCENE_STACK) {
+            fprintf(stderr, "Scene BVH too deep to traverse.\n");
+            break;
+        }
+        stack[top] = node->first;
+        inside[top++] = in;
+        stack[top] = node->first + 1;
+        inside[top++] = in;
+    }
+
+    return count;
+}
+
+// entry distance along the ray, or FLT_MAX on a miss
+static float ray_box(const float *min, const float *max, const float origin[3], const float inv[3])
+{
+    float tmin = 0.0f, tmax = FLT_MAX;
+    for (int k = 0; k < 3; k++) {
+        float t0 = (min[k] - origin[k]) * inv[k];
+        float t1 = (max[k] - origin[k]) * inv[k];
+        if (t0 > t1) { float t = t0; t0 = t1; t1 = t; }
+        if (t0 > tmin) tmin = t0;
+        if (t1 < tmax) tmax = t1;
+    }
+    return tmin <= tmax ? tmin : FLT_MAX;
+}
+
+// the object whose world box the ray enters first, or -1
+int scene_pick(scene *s, const float origin[3], const float dir[3], float *distance)
+{
+    if (!s->built && !scene_build(s))
+        return -1;
+    if (s->len == 0)
+        return -1;
+
+    float inv[3] = { 1.0f / dir[0], 1.0f / dir[1], 1.0f / dir[2] };
+    float best = FLT_MAX;
+    int hit = -1;
+
+    int stack[SCENE_STACK];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0) {
+        const bvhnode *node = &s->nodes[stack[--top]];
+        if (ray_box(node->min, node->max, origin, inv) >= best)
+            continue;
+
+        if (node->count > 0) {
+            for (int i = node->first; i < node->first + node->count; i++) {
+                const float *box = s->worldBounds[s->order[i]];
+                float t = ray_box(box, box + 3, origin, inv);
+                if (t < best) {
+                    best = t;
+                    hit = s->order[i];
+                }
+            }
+            continue;
+        }
+
+        if (top + 2 > SCENE_STACK)
+            break;
+
+        // push the far child first so the near one is visited first
+        const bvhnode *a = &s->nodes[node->first], *b = &s->nodes[node->first + 1];
+        float ta = ray_box(a->min, a->max, origin, inv), tb = ray_box(b->min, b->max, origin, inv);
+        if (ta <= tb) {
+            stack[top++] = node->first + 1;
+            stack[top++] = node->first;
+        } else {
+            stack[top++] = node->first;
+            stack[top++] = node->first + 1;
+        }
+    }
+
+    if (distance)
+        *distance = best;
+    return hit;
+}
+
+void scene_destroy(scene *s)
+{
+    if (s->bounds.cx)
+        cull_destroy(&s->bounds);
+
+    free(s->transforms);
+    free(s->localBounds);
+    free(s->worldBounds);
+    free(s->nodes);
+    free(s->parents);
+    free(s->dirty);
+    free(s->order);
+    free(s->slots);
+    free(s->leaves);
+    memset(s, 0, sizeof(scene));
+}
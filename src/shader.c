@@ -1,4 +1,335 @@
 #include <shader.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+typedef struct {
+    uint32_t magic;
+    uint32_t format;
+    uint32_t length;
+    uint32_t reserved;
+    uint64_t key;
+} cacheheader;
+
+static char *read_file(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        perror("Failed to open file.");
+        return NULL;
+    }
+
+    char *buf;
+    size_t len;
+
+    fseek(fp, 0, SEEK_END);
+    len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    buf = (char *) malloc(len + 1);
+    len = fread(buf, 1, len, fp);
+    buf[len] = '\0';
+    fclose(fp);
+
+    return buf;
+}
+
+/*
+ * GLSL preprocessing: #include "file" is resolved relative to the including
+ * file (each file is pulled in once, which also breaks cycles), #version
+ * lines in included files are dropped, and the permutation defines go
+ * right after the main file's #version. #line directives keep compiler
+ * errors pointing at the right line; the source number is the file's
+ * position in include order, 0 being the main file. before GLSL 4.20,
+ * #line N numbers the line after it N + 1, so the numbers are shifted down
+ * by one for those versions (and for sources without #version).
+ *
+ * #include lines inside block comments and #if 0 blocks are left alone.
+ * other conditionals are not evaluated: an #include under #ifdef is always
+ * pulled in (its text stays inside the block, so the compiler still drops
+ * it), which also counts as that file's one inclusion.
+ */
+
+#define MAX_INCLUDES 32
+#define MAX_DEFINES  64
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} strbuf;
+
+typedef void (*include_fn)(const char *path, void *user);
+
+typedef struct {
+    strbuf out;
+    char *files[MAX_INCLUDES];
+    int count;
+    include_fn onInclude;
+    void *user;
+    int lineShift;      // 1 when #line names its own line, below 4.20
+} ppstate;
+
+static void sb_append(strbuf *sb, const char *str, size_t len)
+{
+    if (sb->len + len + 1 > sb->cap) {
+        while (sb->len + len + 1 > sb->cap)
+            sb->cap = sb->cap ? sb->cap * 2 : 4096;
+        sb->data = (char *) realloc(sb->data, sb->cap);
+    }
+
+    memcpy(sb->data + sb->len, str, len);
+    sb->len += len;
+    sb->data[sb->len] = '\0';
+}
+
+// make the next output line report as this line of the file
+static void pp_line(ppstate *pp, int line, int file)
+{
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "#line %d %d\n", line - pp->lineShift, file);
+    sb_append(&pp->out, buf, len);
+}
+
+static int compare_strings(const void *a, const void *b)
+{
+    return strcmp(*(const char **) a, *(const char **) b);
+}
+
+// sort the define set so "A B" and "B A" name the same variant.
+// NULL if the set has more names than fit
+static char *normalize_defines(const char *defines)
+{
+    char *copy = strdup(defines ? defines : "");
+    char *tokens[MAX_DEFINES];
+    int count = 0;
+
+    for (char *tok = strtok(copy, " ,\t\n"); tok; tok = strtok(NULL, " ,\t\n")) {
+        if (count == MAX_DEFINES) {
+            fprintf(stderr, "Too many defines in \"%s\" (max %d).\n", defines, MAX_DEFINES);
+            free(copy);
+            return NULL;
+        }
+        tokens[count++] = tok;
+    }
+    qsort(tokens, count, sizeof(char *), compare_strings);
+
+    strbuf out = { NULL, 0, 0 };
+    sb_append(&out, "", 0);
+    for (int i = 0; i < count; i++) {
+        if (i > 0) sb_append(&out, " ", 1);
+        sb_append(&out, tokens[i], strlen(tokens[i]));
+    }
+
+    free(copy);
+    return out.data;
+}
+
+// "NAME" or "NAME=VALUE", space separated
+static void emit_defines(strbuf *out, const char *defines)
+{
+    if (defines == NULL)
+        return;
+
+    for (const char *ptr = defines; *ptr; ) {
+        size_t len = strcspn(ptr, " ");
+        if (len > 0) {
+            const char *eq = memchr(ptr, '=', len);
+            sb_append(out, "#define ", 8);
+            if (eq) {
+                sb_append(out, ptr, eq - ptr);
+                sb_append(out, " ", 1);
+                sb_append(out, eq + 1, len - (eq - ptr) - 1);
+            } else {
+                sb_append(out, ptr, len);
+            }
+            sb_append(out, "\n", 1);
+        }
+        ptr += len;
+        while (*ptr == ' ') ptr++;
+    }
+}
+
+// whether a block comment is open at the end of a line, given it was at the start
+static int comment_open(const char *line, size_t len, int open)
+{
+    for (size_t i = 0; i + 1 < len; i++) {
+        if (open) {
+            if (line[i] == '*' && line[i + 1] == '/') {
+                open = 0;
+                i++;
+            }
+        } else if (line[i] == '/' && line[i + 1] == '/') {
+            break;
+        } else if (line[i] == '/' && line[i + 1] == '*') {
+            open = 1;
+            i++;
+        }
+    }
+    return open;
+}
+
+// whether a directive line starts with the keyword, as a whole word
+static int is_directive(const char *directive, const char *keyword)
+{
+    size_t len = strlen(keyword);
+    return strncmp(directive, keyword, len) == 0 && !isalnum((unsigned char) directive[len]) && directive[len] != '_';
+}
+
+static int preprocess_file(ppstate *pp, const char *path, const char *defines)
+{
+    for (int i = 0; i < pp->count; i++) {
+        if (strcmp(pp->files[i], path) == 0)
+            return 1;
+    }
+
+    if (pp->count == MAX_INCLUDES) {
+        fprintf(stderr, "Too many includes at %s.\n", path);
+        return 0;
+    }
+
+    char *src = read_file(path);
+    if (src == NULL)
+        return 0;
+
+    int index = pp->count;
+    pp->files[pp->count++] = strdup(path);
+    if (index > 0 && pp->onInclude)
+        pp->onInclude(path, pp->user);
+
+    // the main file's defines wait for its #version line, if it has one
+    int top = index == 0;
+    const char *version = top ? strstr(src, "#version") : NULL;
+    int definesPending = version != NULL;
+    if (top)
+        pp->lineShift = version == NULL || strtol(version + 8, NULL, 10) < 420;
+
+    if (top && !definesPending) {
+        emit_defines(&pp->out, defines);
+        pp_line(pp, 1, index);
+    } else if (!top) {
+        pp_line(pp, 1, index);
+    }
+
+    int status = 1;
+    int line = 1;
+    int comment = 0;    // inside a block comment
+    int disabled = 0;   // #if nesting depth inside an #if 0 block
+
+    for (char *ptr = src; *ptr && status; line++) {
+        size_t len = strcspn(ptr, "\n");
+        char *next = ptr[len] ? ptr + len + 1 : ptr + len;
+
+        const char *directive = ptr;
+        while (*directive == ' ' || *directive == '\t')
+            directive++;
+
+        int commented = comment;
+        comment = comment_open(ptr, len, comment);
+
+        if (!commented && disabled) {
+            if (is_directive(directive, "#if") || is_directive(directive, "#ifdef") || is_directive(directive, "#ifndef"))
+                disabled++;
+            else if (is_directive(directive, "#endif"))
+                disabled--;
+            else if (disabled == 1 && (is_directive(directive, "#else") || is_directive(directive, "#elif")))
+                disabled = 0;
+        } else if (!commented && is_directive(directive, "#if")) {
+            const char *expr = directive + 3;
+            while (*expr == ' ' || *expr == '\t')
+                expr++;
+            if (*expr == '0' && !isalnum((unsigned char) expr[1]))
+                disabled = 1;
+        }
+
+        if (commented || disabled) {
+            sb_append(&pp->out, ptr, len);
+            sb_append(&pp->out, "\n", 1);
+        } else if (strncmp(directive, "#include", 8) == 0) {
+            const char *open = memchr(directive, '"', ptr + len - directive);
+            const char *close = open ? memchr(open + 1, '"', ptr + len - open - 1) : NULL;
+            if (close == NULL) {
+                fprintf(stderr, "%s:%d: malformed #include\n", path, line);
+                status = 0;
+                break;
+            }
+
+            // relative to the including file's directory
+            const char *slash = strrchr(path, '/');
+            int dirLen = slash ? (int) (slash - path + 1) : 0;
+
+            char include[512];
+            snprintf(include, sizeof(include), "%.*s%.*s", dirLen, path, (int) (close - open - 1), open + 1);
+
+            status = preprocess_file(pp, include, NULL);
+            pp_line(pp, line + 1, index);
+        } else if (strncmp(directive, "#version", 8) == 0) {
+            if (top) {
+                sb_append(&pp->out, ptr, len);
+                sb_append(&pp->out, "\n", 1);
+            } else {
+                sb_append(&pp->out, "\n", 1);
+            }
+
+            if (definesPending) {
+                emit_defines(&pp->out, defines);
+                pp_line(pp, line + 1, index);
+                definesPending = 0;
+            }
+        } else {
+            sb_append(&pp->out, ptr, len);
+            sb_append(&pp->out, "\n", 1);
+        }
+
+        ptr = next;
+    }
+
+    free(src);
+    return status;
+}
+
+static char *preprocess(const char *path, const char *defines, include_fn onInclude, void *user)
+{
+    ppstate pp = { { NULL, 0, 0 }, { NULL }, 0, onInclude, user, 0 };
+    int status = preprocess_file(&pp, path, defines);
+
+    for (int i = 0; i < pp.count; i++)
+        free(pp.files[i]);
+
+    if (!status) {
+        free(pp.out.data);
+        return NULL;
+    }
+
+    return pp.out.data;
+}
+
+static uint64_t hash_bytes(uint64_t h, const void *data, size_t len)
+{
+    // fnv-1a, 64-bit
+    const unsigned char *bytes = (const unsigned char *) data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= bytes[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static uint64_t hash_string(uint64_t h, const char *s)
+{
+    // include the terminator so "ab" + "c" and "a" + "bc" differ
+    return hash_bytes(h, s ? s : "", s ? strlen(s) + 1 : 1);
+}
+
+// hook the program up to the shared per-frame block, if it uses it
+static void bind_blocks(program prog)
+{
+    unsigned int block = glGetUniformBlockIndex(prog, SHADER_FRAMEDATA_BLOCK);
+    if (block != GL_INVALID_INDEX)
+        glUniformBlockBinding(prog, block, SHADER_FRAMEDATA_BINDING);
+}
 
 int shader_load(const char *source, GLenum type, shader *shd)
 {
@@ -22,23 +353,9 @@ int shader_load(const char *source, GLenum type, shader *shd)
 
 int shader_loadFile(const char *path, GLenum type, shader *shd)
 {
-    FILE *fp = fopen(path, "r");
-    if (fp == NULL) {
-        perror("Failed to open file.");
+    char *buf = preprocess(path, NULL, NULL, NULL);
+    if (buf == NULL)
         return 0;
-    }
-
-    char *buf;
-    size_t len;
-
-    fseek(fp, 0, SEEK_END);
-    len = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
-
-    buf = (char *) malloc(len + 1);
-    fread(buf, 1, len, fp);
-    buf[len] = '\0';
-    fclose(fp);
 
     int status = shader_load(buf, type, shd);
     free(buf);
@@ -66,6 +383,576 @@ int shader_createProgram(program *prog, int len, ...)
         printf("Failed to link program:\n%s\n", infoLog);
     }
 
+    bind_blocks(temp);
+
     *prog = temp;
     return 1;
 }
+
+static void cache_path(uint64_t key, char *path, size_t size)
+{
+    snprintf(path, size, "%s/%016llx.bin", SHADER_CACHE_DIR, (unsigned long long) key);
+}
+
+static int cache_read(uint64_t key, program *prog)
+{
+    char path[256];
+    cache_path(key, path, sizeof(path));
+
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+        return 0;
+
+    // the length comes from disk: it must fit in what's left of the file
+    struct stat st;
+    cacheheader header;
+    void *binary = NULL;
+    int status = fstat(fileno(fp), &st) == 0
+        && fread(&header, sizeof(header), 1, fp) == 1
+        && header.magic == SHADER_CACHE_MAGIC && header.key == key
+        && header.length <= (uint64_t) st.st_size - sizeof(header);
+
+    if (status) {
+        binary = malloc(header.length);
+        status = binary != NULL && fread(binary, 1, header.length, fp) == header.length;
+    }
+    fclose(fp);
+
+    if (!status) {
+        free(binary);
+        return 0;
+    }
+
+    // the driver may still reject it, e.g. after an update it didn't report
+    program temp = glCreateProgram();
+    glProgramBinary(temp, header.format, binary, header.length);
+    free(binary);
+
+    glGetProgramiv(temp, GL_LINK_STATUS, &status);
+    if (!status) {
+        glDeleteProgram(temp);
+        return 0;
+    }
+
+    *prog = temp;
+    return 1;
+}
+
+static void cache_write(uint64_t key, program prog)
+{
+    GLint length = 0;
+    glGetProgramiv(prog, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    cacheheader header = { SHADER_CACHE_MAGIC, 0, 0, 0, key };
+    void *binary = malloc(length);
+    if (binary == NULL)
+        return;
+
+    GLenum format;
+    GLsizei written = 0;
+    glGetProgramBinary(prog, length, &written, &format, binary);
+    header.format = format;
+    header.length = written;
+
+    if (mkdir(SHADER_CACHE_DIR, 0755) != 0 && errno != EEXIST) {
+        perror("Failed to create shader cache.");
+        free(binary);
+        return;
+    }
+
+    // written beside the target and renamed over it, so a crash never
+    // leaves a torn entry behind
+    char path[256], temp[272];
+    cache_path(key, path, sizeof(path));
+    snprintf(temp, sizeof(temp), "%s.%d.tmp", path, (int) getpid());
+
+    FILE *fp = fopen(temp, "wb");
+    if (fp != NULL) {
+        int ok = fwrite(&header, sizeof(header), 1, fp) == 1
+            && fwrite(binary, 1, written, fp) == (size_t) written;
+        ok = fclose(fp) == 0 && ok;
+
+        if (!ok || rename(temp, path) != 0)
+            remove(temp);
+    }
+
+    free(binary);
+}
+
+void shader_batchCreate(shaderbatch *batch)
+{
+    batch->jobs = NULL;
+    batch->len = 0;
+    batch->cap = 0;
+    batch->parallel = GLAD_GL_KHR_parallel_shader_compile;
+
+    // let the driver pick how many compiler threads to use
+    if (batch->parallel)
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+}
+
+static int batch_add(shaderbatch *batch, program *prog, shader_callback callback, void *user,
+                     const char *defines, int len, const char **paths, const GLenum *types)
+{
+    if (len > SHADER_MAX_STAGES) {
+        fprintf(stderr, "Too many shader stages (%d).\n", len);
+        if (callback) callback(0, 0, user);
+        return 0;
+    }
+
+    char *sources[SHADER_MAX_STAGES] = { NULL };
+
+    // key: every stage's type and expanded source, plus the driver that built it
+    uint64_t key = 14695981039346656037ull;
+    int status = 1;
+
+    for (int i = 0; i < len && status; i++) {
+        sources[i] = preprocess(paths[i], defines, NULL, NULL);
+        status = sources[i] != NULL;
+
+        key = hash_bytes(key, &types[i], sizeof(GLenum));
+        key = hash_string(key, sources[i]);
+    }
+
+    key = hash_string(key, (const char *) glGetString(GL_VENDOR));
+    key = hash_string(key, (const char *) glGetString(GL_RENDERER));
+    key = hash_string(key, (const char *) glGetString(GL_VERSION));
+
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+
+    program temp = 0;
+    if (!status || (formats > 0 && cache_read(key, &temp))) {
+        for (int i = 0; i < len; i++)
+            free(sources[i]);
+
+        if (status) {
+            bind_blocks(temp);
+            *prog = temp;
+        }
+        if (callback) callback(status ? temp : 0, status, user);
+        return status;
+    }
+
+    if (batch->len == batch->cap) {
+        batch->cap = batch->cap ? batch->cap * 2 : 8;
+        batch->jobs = realloc(batch->jobs, batch->cap * sizeof(shaderjob));
+    }
+
+    shaderjob *job = &batch->jobs[batch->len++];
+    job->target = prog;
+    job->callback = callback;
+    job->user = user;
+    job->key = formats > 0 ? key : 0;
+    job->len = len;
+
+    /*
+     * Issue every compile and the link back to back without asking for a
+     * status in between, any query would wait for the driver to finish.
+     * with the extension the work runs on the driver's compiler threads.
+     */
+
+    job->prog = glCreateProgram();
+    for (int i = 0; i < len; i++) {
+        job->shaders[i] = glCreateShader(types[i]);
+        glShaderSource(job->shaders[i], 1, (const char **) &sources[i], NULL);
+        glCompileShader(job->shaders[i]);
+        glAttachShader(job->prog, job->shaders[i]);
+        free(sources[i]);
+    }
+
+    glProgramParameteri(job->prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(job->prog);
+
+    return 1;
+}
+
+// unpack (path, type) pairs
+static int vbatch_add(shaderbatch *batch, program *prog, shader_callback callback, void *user,
+                      int len, va_list args)
+{
+    const char *paths[SHADER_MAX_STAGES];
+    GLenum types[SHADER_MAX_STAGES];
+
+    for (int i = 0; i < len && i < SHADER_MAX_STAGES; i++) {
+        paths[i] = va_arg(args, const char *);
+        types[i] = va_arg(args, GLenum);
+    }
+
+    return batch_add(batch, prog, callback, user, NULL, len, paths, types);
+}
+
+int shader_batchAdd(shaderbatch *batch, program *prog, shader_callback callback, void *user, int len, ...)
+{
+    va_list args;
+    va_start(args, len);
+    int status = vbatch_add(batch, prog, callback, user, len, args);
+    va_end(args);
+
+    return status;
+}
+
+static void finish_job(shaderjob *job)
+{
+    int status;
+    char infoLog[512];
+    glGetProgramiv(job->prog, GL_LINK_STATUS, &status);
+
+    if (!status) {
+        // the link log is often just "attached shader failed", show the stage logs too
+        for (int i = 0; i < job->len; i++) {
+            int compiled;
+            glGetShaderiv(job->shaders[i], GL_COMPILE_STATUS, &compiled);
+            if (!compiled) {
+                glGetShaderInfoLog(job->shaders[i], 512, NULL, infoLog);
+                fprintf(stderr, "Failed to compile shader:\n%s\n", infoLog);
+            }
+        }
+
+        glGetProgramInfoLog(job->prog, 512, NULL, infoLog);
+        fprintf(stderr, "Failed to link program:\n%s\n", infoLog);
+    }
+
+    for (int i = 0; i < job->len; i++) {
+        glDetachShader(job->prog, job->shaders[i]);
+        glDeleteShader(job->shaders[i]);
+    }
+
+    if (!status) {
+        glDeleteProgram(job->prog);
+        if (job->callback) job->callback(0, 0, job->user);
+        return;
+    }
+
+    if (job->key)
+        cache_write(job->key, job->prog);
+    bind_blocks(job->prog);
+
+    *job->target = job->prog;
+    if (job->callback) job->callback(job->prog, 1, job->user);
+}
+
+int shader_batchPoll(shaderbatch *batch)
+{
+    for (int i = 0; i < batch->len; ) {
+        shaderjob *job = &batch->jobs[i];
+
+        // without the extension this falls through to a blocking status query
+        int done = 1;
+        if (batch->parallel)
+            glGetProgramiv(job->prog, GL_COMPLETION_STATUS_KHR, &done);
+
+        if (!done) {
+            i++;
+            continue;
+        }
+
+        // copy out first, the callback may add more jobs
+        shaderjob finished = *job;
+        batch->jobs[i] = batch->jobs[--batch->len];
+        finish_job(&finished);
+    }
+
+    return batch->len;
+}
+
+void shader_batchWait(shaderbatch *batch)
+{
+    // block on the link status instead of spinning on completion queries
+    int parallel = batch->parallel;
+    batch->parallel = 0;
+    shader_batchPoll(batch);
+    batch->parallel = parallel;
+}
+
+void shader_batchDestroy(shaderbatch *batch)
+{
+    // abandoned jobs still own their GL objects
+    for (int i = 0; i < batch->len; i++) {
+        shaderjob *job = &batch->jobs[i];
+        for (int j = 0; j < job->len; j++)
+            glDeleteShader(job->shaders[j]);
+        glDeleteProgram(job->prog);
+    }
+
+    free(batch->jobs);
+    batch->jobs = NULL;
+    batch->len = batch->cap = 0;
+}
+
+int shader_loadProgram(program *prog, int len, ...)
+{
+    shaderbatch batch;
+    shader_batchCreate(&batch);
+
+    program temp = 0;
+
+    va_list args;
+    va_start(args, len);
+    vbatch_add(&batch, &temp, NULL, NULL, len, args);
+    va_end(args);
+
+    shader_batchWait(&batch);
+    shader_batchDestroy(&batch);
+
+    if (temp == 0)
+        return 0;
+
+    *prog = temp;
+    return 1;
+}
+
+int shader_reloaderCreate(shaderreloader *r)
+{
+    r->programs = NULL;
+    r->len = 0;
+    r->cap = 0;
+
+    shader_batchCreate(&r->batch);
+    return watch_create(&r->watch);
+}
+
+static void reloaded(program prog, int status, void *user)
+{
+    shaderprogram *entry = (shaderprogram *) user;
+    entry->pending = 0;
+
+    // keep the old program running when the new one fails to build
+    if (!status)
+        return;
+
+    if (*entry->target != 0)
+        glDeleteProgram(*entry->target);
+    *entry->target = prog;
+
+    if (entry->callback)
+        entry->callback(prog, 1, entry->user);
+}
+
+static void watch_file(shaderprogram *entry, watcher *watch, const char *path)
+{
+    int file = watch_add(watch, path);
+    if (file < 0)
+        return;
+
+    for (int i = 0; i < entry->fileCount; i++) {
+        if (entry->files[i] == file)
+            return;
+    }
+
+    if (entry->fileCount == entry->fileCap) {
+        entry->fileCap = entry->fileCap ? entry->fileCap * 2 : 8;
+        entry->files = (int *) realloc(entry->files, entry->fileCap * sizeof(int));
+    }
+    entry->files[entry->fileCount++] = file;
+}
+
+typedef struct {
+    shaderreloader *r;
+    shaderprogram *entry;
+} includectx;
+
+static void watch_include(const char *path, void *user)
+{
+    includectx *ctx = (includectx *) user;
+    watch_file(ctx->entry, &ctx->r->watch, path);
+}
+
+static void submit(shaderreloader *r, shaderprogram *entry)
+{
+    entry->dirty = 0;
+    entry->pending = 1;
+
+    // refresh the watched files, the edit may have added an #include
+    includectx ctx = { r, entry };
+    for (int i = 0; i < entry->len; i++) {
+        watch_file(entry, &r->watch, entry->paths[i]);
+        free(preprocess(entry->paths[i], NULL, watch_include, &ctx));
+    }
+
+    batch_add(&r->batch, &entry->built, reloaded, entry, entry->defines, entry->len,
+              (const char **) entry->paths, entry->types);
+}
+
+static int reloader_add(shaderreloader *r, program *prog, shader_callback callback, void *user,
+                        const char *defines, int len, const char **paths, const GLenum *types)
+{
+    if (len > SHADER_MAX_STAGES) {
+        fprintf(stderr, "Too many shader stages (%d).\n", len);
+        return 0;
+    }
+
+    shaderprogram *entry = (shaderprogram *) calloc(1, sizeof(shaderprogram));
+    entry->target = prog;
+    entry->callback = callback;
+    entry->user = user;
+    entry->defines = defines ? strdup(defines) : NULL;
+    entry->len = len;
+
+    for (int i = 0; i < len; i++) {
+        entry->paths[i] = strdup(paths[i]);
+        entry->types[i] = types[i];
+    }
+
+    if (r->len == r->cap) {
+        r->cap = r->cap ? r->cap * 2 : 8;
+        r->programs = (shaderprogram **) realloc(r->programs, r->cap * sizeof(shaderprogram *));
+    }
+    r->programs[r->len++] = entry;
+
+    // the first build is synchronous, the caller needs a program to draw with
+    *prog = 0;
+    submit(r, entry);
+    shader_batchWait(&r->batch);
+
+    return *prog != 0;
+}
+
+int shader_reloaderAdd(shaderreloader *r, program *prog, shader_callback callback, void *user, int len, ...)
+{
+    const char *paths[SHADER_MAX_STAGES];
+    GLenum types[SHADER_MAX_STAGES];
+
+    va_list args;
+    va_start(args, len);
+    for (int i = 0; i < len && i < SHADER_MAX_STAGES; i++) {
+        paths[i] = va_arg(args, const char *);
+        types[i] = va_arg(args, GLenum);
+    }
+    va_end(args);
+
+    return reloader_add(r, prog, callback, user, NULL, len, paths, types);
+}
+
+static void changed(int file, void *user)
+{
+    shaderreloader *r = (shaderreloader *) user;
+
+    for (int i = 0; i < r->len; i++) {
+        for (int j = 0; j < r->programs[i]->fileCount; j++) {
+            if (r->programs[i]->files[j] == file)
+                r->programs[i]->dirty = 1;
+        }
+    }
+}
+
+void shader_reloaderUpdate(shaderreloader *r)
+{
+    watch_poll(&r->watch, changed, r);
+
+    // a save during a rebuild is picked up once that rebuild lands
+    for (int i = 0; i < r->len; i++) {
+        shaderprogram *entry = r->programs[i];
+        if (entry->dirty && !entry->pending) {
+            fprintf(stderr, "Reloading %s\n", entry->paths[entry->len - 1]);
+            submit(r, entry);
+        }
+    }
+
+    shader_batchPoll(&r->batch);
+}
+
+void shader_reloaderDestroy(shaderreloader *r)
+{
+    shader_batchDestroy(&r->batch);
+    watch_destroy(&r->watch);
+
+    for (int i = 0; i < r->len; i++) {
+        for (int j = 0; j < r->programs[i]->len; j++)
+            free(r->programs[i]->paths[j]);
+        free(r->programs[i]->defines);
+        free(r->programs[i]->files);
+        free(r->programs[i]);
+    }
+    free(r->programs);
+    r->programs = NULL;
+    r->len = r->cap = 0;
+}
+
+int shader_variantsCreate(shadervariants *v, shaderreloader *reloader, int len, ...)
+{
+    v->reloader = reloader;
+    v->variants = NULL;
+    v->count = 0;
+    v->cap = 0;
+    v->len = 0;
+
+    if (len > SHADER_MAX_STAGES) {
+        fprintf(stderr, "Too many shader stages (%d).\n", len);
+        return 0;
+    }
+
+    va_list args;
+    va_start(args, len);
+    for (int i = 0; i < len; i++) {
+        v->paths[i] = strdup(va_arg(args, const char *));
+        v->types[i] = va_arg(args, GLenum);
+    }
+    va_end(args);
+
+    v->len = len;
+    return 1;
+}
+
+// look up the program built with this define set, building it on first use
+int shader_variant(shadervariants *v, const char *defines, program *prog)
+{
+    char *normalized = normalize_defines(defines);
+    if (normalized == NULL) {
+        *prog = 0;
+        return 0;
+    }
+
+    uint64_t key = hash_string(14695981039346656037ull, normalized);
+
+    for (int i = 0; i < v->count; i++) {
+        if (v->variants[i]->key == key) {
+            free(normalized);
+            *prog = v->variants[i]->prog;
+            return *prog != 0;
+        }
+    }
+
+    // failed builds stay in the table too, so they aren't retried every frame
+    shadervariant *variant = (shadervariant *) calloc(1, sizeof(shadervariant));
+    variant->key = key;
+
+    if (v->reloader) {
+        reloader_add(v->reloader, &variant->prog, NULL, NULL, normalized,
+                     v->len, (const char **) v->paths, v->types);
+    } else {
+        shaderbatch batch;
+        shader_batchCreate(&batch);
+        batch_add(&batch, &variant->prog, NULL, NULL, normalized,
+                  v->len, (const char **) v->paths, v->types);
+        shader_batchWait(&batch);
+        shader_batchDestroy(&batch);
+    }
+    free(normalized);
+
+    if (v->count == v->cap) {
+        v->cap = v->cap ? v->cap * 2 : 8;
+        v->variants = (shadervariant **) realloc(v->variants, v->cap * sizeof(shadervariant *));
+    }
+    v->variants[v->count++] = variant;
+
+    *prog = variant->prog;
+    return *prog != 0;
+}
+
+void shader_variantsDestroy(shadervariants *v)
+{
+    for (int i = 0; i < v->count; i++) {
+        if (v->variants[i]->prog != 0)
+            glDeleteProgram(v->variants[i]->prog);
+        free(v->variants[i]);
+    }
+    for (int i = 0; i < v->len; i++)
+        free(v->paths[i]);
+
+    free(v->variants);
+    v->variants = NULL;
+    v->count = v->cap = v->len = 0;
+}
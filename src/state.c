@@ -0,0 +1,141 @@
+#include <state.h>
+#include <string.h>
+
+// nothing gl hands out or accepts, so the first call after this always goes through
+#define UNKNOWN 0xFFFFFFFFu
+
+void state_create(glstate *s)
+{
+    s->calls = 0;
+    s->elided = 0;
+    state_invalidate(s);
+}
+
+void state_invalidate(glstate *s)
+{
+    s->prog = UNKNOWN;
+    s->vao = UNKNOWN;
+    for (int i = 0; i < STATE_TEXTURE_UNITS; i++)
+        s->textures[i] = UNKNOWN;
+
+    s->blend = -1;
+    s->blendSrc = s->blendDst = UNKNOWN;
+    s->depthTest = -1;
+    s->depthWrite = -1;
+    s->depthFunc = UNKNOWN;
+    s->cullFace = -1;
+    s->viewport[0] = s->viewport[1] = s->viewport[2] = s->viewport[3] = -1;
+}
+
+// count the call, return whether it has to be made
+static int update(glstate *s, int same)
+{
+    if (same) {
+        s->elided++;
+        return 0;
+    }
+
+    s->calls++;
+    return 1;
+}
+
+static void toggle(GLenum cap, int enable)
+{
+    if (enable)
+        glEnable(cap);
+    else
+        glDisable(cap);
+}
+
+void state_useProgram(glstate *s, GLuint prog)
+{
+    if (update(s, s->prog == prog)) {
+        glUseProgram(prog);
+        s->prog = prog;
+    }
+}
+
+void state_bindVertexArray(glstate *s, GLuint vao)
+{
+    if (update(s, s->vao == vao)) {
+        glBindVertexArray(vao);
+        s->vao = vao;
+    }
+}
+
+void state_bindTexture(glstate *s, int unit, GLuint texture)
+{
+    if (unit < 0 || unit >= STATE_TEXTURE_UNITS) {
+        // untracked unit, pass it straight through
+        glBindTextureUnit(unit, texture);
+        s->calls++;
+        return;
+    }
+
+    if (update(s, s->textures[unit] == texture)) {
+        glBindTextureUnit(unit, texture);
+        s->textures[unit] = texture;
+    }
+}
+
+void state_blend(glstate *s, int enable)
+{
+    enable = !!enable;
+    if (update(s, s->blend == enable)) {
+        toggle(GL_BLEND, enable);
+        s->blend = enable;
+    }
+}
+
+void state_blendFunc(glstate *s, GLenum src, GLenum dst)
+{
+    if (update(s, s->blendSrc == src && s->blendDst == dst)) {
+        glBlendFunc(src, dst);
+        s->blendSrc = src;
+        s->blendDst = dst;
+    }
+}
+
+void state_depthTest(glstate *s, int enable)
+{
+    enable = !!enable;
+    if (update(s, s->depthTest == enable)) {
+        toggle(GL_DEPTH_TEST, enable);
+        s->depthTest = enable;
+    }
+}
+
+void state_depthWrite(glstate *s, int enable)
+{
+    enable = !!enable;
+    if (update(s, s->depthWrite == enable)) {
+        glDepthMask(enable ? GL_TRUE : GL_FALSE);
+        s->depthWrite = enable;
+    }
+}
+
+void state_depthFunc(glstate *s, GLenum func)
+{
+    if (update(s, s->depthFunc == func)) {
+        glDepthFunc(func);
+        s->depthFunc = func;
+    }
+}
+
+void state_cullFace(glstate *s, int enable)
+{
+    enable = !!enable;
+    if (update(s, s->cullFace == enable)) {
+        toggle(GL_CULL_FACE, enable);
+        s->cullFace = enable;
+    }
+}
+
+void state_viewport(glstate *s, GLint x, GLint y, GLint w, GLint h)
+{
+    GLint viewport[4] = { x, y, w, h };
+    if (update(s, memcmp(s->viewport, viewport, sizeof(viewport)) == 0)) {
+        glViewport(x, y, w, h);
+        memcpy(s->viewport, viewport, sizeof(viewport));
+    }
+}
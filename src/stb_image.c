@@ -1,2 +1,52 @@
+#include <imagealloc.h>
+#include <string.h>
+
+// the calling thread's output target, see imagealloc.h
+static _Thread_local struct {
+    void *dst;
+    size_t size;
+    int taken;
+} target;
+
+void imagealloc_target(void *dst, size_t size)
+{
+    target.dst = dst;
+    target.size = size;
+    target.taken = 0;
+}
+
+static void *image_malloc(size_t size)
+{
+    if (target.dst != NULL && !target.taken && size == target.size) {
+        target.taken = 1;
+        return target.dst;
+    }
+    return malloc(size);
+}
+
+static void image_free(void *p)
+{
+    if (p != NULL && p == target.dst) target.taken = 0;
+    else                              free(p);
+}
+
+static void *image_realloc(void *p, size_t size)
+{
+    if (p == NULL || p != target.dst)
+        return realloc(p, size);
+
+    // the target only ever holds the size it was given, move out of it
+    void *q = malloc(size);
+    if (q != NULL) {
+        memcpy(q, p, size < target.size ? size : target.size);
+        target.taken = 0;
+    }
+    return q;
+}
+
+#define STBI_MALLOC(size)     image_malloc(size)
+#define STBI_REALLOC(p, size) image_realloc(p, size)
+#define STBI_FREE(p)          image_free(p)
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -0,0 +1,89 @@
+#include <stream.h>
+
+#define STREAM_FLAGS (GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT)
+
+int stream_create(stream *strm, GLenum target, GLsizeiptr frameSize)
+{
+    // keep every region start aligned for uniform/storage buffer binding
+    GLint align = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+    if (align < 256) align = 256;
+
+    strm->regionSize = (frameSize + align - 1) / align * align;
+    strm->head = 0;
+    strm->frame = 0;
+
+    for (int i = 0; i < STREAM_FRAMES; i++)
+        strm->fences[i] = NULL;
+
+    glGenBuffers(1, &strm->buffer);
+    glBindBuffer(target, strm->buffer);
+    glBufferStorage(target, strm->regionSize * STREAM_FRAMES, NULL, STREAM_FLAGS);
+
+    strm->mapped = (unsigned char *) glMapBufferRange(target, 0, strm->regionSize * STREAM_FRAMES, STREAM_FLAGS);
+
+    if (strm->mapped == NULL) {
+        fprintf(stderr, "Failed to map stream buffer.\n");
+        glDeleteBuffers(1, &strm->buffer);
+        return 0;
+    }
+
+    return 1;
+}
+
+void stream_begin(stream *strm)
+{
+    GLsync fence = strm->fences[strm->frame];
+
+    // wait until the gpu is done with the frame that last used this region
+    if (fence != NULL) {
+        GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        GLenum status;
+
+        do {
+            status = glClientWaitSync(fence, flags, 1000000000);
+            flags = 0;
+        } while (status == GL_TIMEOUT_EXPIRED);
+
+        glDeleteSync(fence);
+        strm->fences[strm->frame] = NULL;
+    }
+
+    strm->head = 0;
+}
+
+void *stream_alloc(stream *strm, GLsizeiptr size, GLsizeiptr align, GLintptr *offset)
+{
+    GLintptr start = (strm->head + align - 1) / align * align;
+
+    if (start + size > strm->regionSize) {
+        fprintf(stderr, "Stream buffer region overflow (%ld bytes).\n", (long) size);
+        return NULL;
+    }
+
+    strm->head = start + size;
+
+    *offset = strm->frame * strm->regionSize + start;
+    return strm->mapped + *offset;
+}
+
+void stream_end(stream *strm)
+{
+    strm->fences[strm->frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    strm->frame = (strm->frame + 1) % STREAM_FRAMES;
+}
+
+void stream_destroy(stream *strm)
+{
+    for (int i = 0; i < STREAM_FRAMES; i++) {
+        if (strm->fences[i] != NULL)
+            glDeleteSync(strm->fences[i]);
+        strm->fences[i] = NULL;
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, strm->buffer);
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    glDeleteBuffers(1, &strm->buffer);
+
+    strm->mapped = NULL;
+}
@@ -0,0 +1,445 @@
+#include <texture.h>
+#include <imagealloc.h>
+#include <mip.h>
+#include <string.h>
+#include <strings.h>
+#include <limits.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "stb_image.h"
+
+static int has_extension(const char *path, const char *ext)
+{
+    size_t len = strlen(path), extLen = strlen(ext);
+    return len >= extLen && strcasecmp(path + len - extLen, ext) == 0;
+}
+
+static int map_file(texture *tex)
+{
+    int fd = open(tex->path, O_RDONLY);
+    if (fd < 0) {
+        perror("Failed to open texture file.");
+        return 0;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0 || st.st_size > INT_MAX) {
+        fprintf(stderr, "Texture file %s is empty or too large.\n", tex->path);
+        close(fd);
+        return 0;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED) {
+        perror("Failed to map texture file.");
+        return 0;
+    }
+
+    // decoded or uploaded front to back, read it ahead
+    madvise(map, st.st_size, MADV_WILLNEED | MADV_SEQUENTIAL);
+
+    tex->file = (unsigned char *) map;
+    tex->fileSize = st.st_size;
+    return 1;
+}
+
+static void unmap_file(texture *tex)
+{
+    if (tex->file == NULL) return;
+
+    munmap(tex->file, tex->fileSize);
+    tex->file = NULL;
+    tex->fileSize = 0;
+}
+
+static void fail(texture *tex)
+{
+    unmap_file(tex);
+    atomic_store(&tex->state, TEXTURE_FAILED);
+}
+
+// first worker pass: map the file and read just enough to size the upload
+static void read_header(void *arg)
+{
+    texture *tex = (texture *) arg;
+
+    if (!map_file(tex)) {
+        atomic_store(&tex->state, TEXTURE_FAILED);
+        return;
+    }
+
+    if (tex->compressed) {
+        if (!dds_parse(tex->file, tex->fileSize, &tex->dds)) {
+            fprintf(stderr, "Failed to load texture %s: not a supported dds file\n", tex->path);
+            fail(tex);
+            return;
+        }
+
+        tex->width = tex->dds.width;
+        tex->height = tex->dds.height;
+        atomic_store(&tex->state, TEXTURE_DECODED);
+        return;
+    }
+
+    int channels;
+    if (!stbi_info_from_memory(tex->file, (int) tex->fileSize, &tex->width, &tex->height, &channels)) {
+        fprintf(stderr, "Failed to load texture %s: %s\n", tex->path, stbi_failure_reason());
+        fail(tex);
+        return;
+    }
+
+    // decode to a layout the gpu stores natively: drivers pad rgb to rgba on
+    // the cpu during the upload, so stb_image fills the alpha instead
+    tex->channels = channels == 3 ? 4 : channels;
+    atomic_store(&tex->state, TEXTURE_SIZED);
+}
+
+// second worker pass: decode into the staging buffer the render thread
+// mapped, then build the rest of the mip chain behind the image
+static void decode(void *arg)
+{
+    texture *tex = (texture *) arg;
+    size_t size = (size_t) tex->width * tex->height * tex->channels;
+
+    // jpeg writes each output row once, front to back, so it can go straight
+    // to the mapping (its output allocation has one byte of slack, which the
+    // staging buffer leaves room for). png unfiltering reads the row above
+    // back, which is slow from write-combined memory: other formats decode on
+    // the heap and are copied over once.
+    if (tex->file[0] == 0xFF && tex->file[1] == 0xD8)
+        imagealloc_target(tex->staging, size + 1);
+
+    int w, h, channels;
+    unsigned char *pixels = stbi_load_from_memory(tex->file, (int) tex->fileSize, &w, &h, &channels, tex->channels);
+    imagealloc_target(NULL, 0);
+    unmap_file(tex);
+
+    if (pixels == NULL) {
+        fprintf(stderr, "Failed to load texture %s: %s\n", tex->path, stbi_failure_reason());
+        atomic_store(&tex->state, TEXTURE_FAILED);
+        return;
+    }
+
+    if (pixels != tex->staging) {
+        memcpy(tex->staging, pixels, size);
+        stbi_image_free(pixels);
+    }
+
+    mip_generate(tex->workers, (unsigned char *) tex->staging, tex->width, tex->height, tex->channels, tex->srgb);
+
+    atomic_store(&tex->state, TEXTURE_DECODED);
+}
+
+// lets stb_image split one large image across the loader's workers
+static void parallel_decode(stbi_parallel_task task, void *ctx, int count, void *user)
+{
+    pool_parallelFor((pool *) user, task, ctx, count);
+}
+
+// largest unpack alignment the rows of an image are a multiple of
+static int row_alignment(int width, int channels)
+{
+    int row = width * channels;
+    return row % 8 == 0 ? 8 : row % 4 == 0 ? 4 : row % 2 == 0 ? 2 : 1;
+}
+
+/*
+ * Bindless handles
+ */
+
+static void publish_handle(texloader *l, texture *tex)
+{
+    if (!l->bindless) return;
+
+    GLuint64 handle = l->placeholderHandle;
+    if (tex->id != l->placeholder) {
+        handle = glGetTextureHandleARB(tex->id);
+        glMakeTextureHandleResidentARB(handle);
+    }
+
+    // grow the buffer with the texture list, re-uploading the mirror
+    if (tex->slot >= l->handleCap) {
+        l->handleCap = l->cap;
+        l->handles = (GLuint64 *) realloc(l->handles, l->handleCap * sizeof(GLuint64));
+        l->handles[tex->slot] = handle;
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, l->handleBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, l->handleCap * sizeof(GLuint64), l->handles, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TEXTURE_HANDLE_BINDING, l->handleBuffer);
+        return;
+    }
+
+    l->handles[tex->slot] = handle;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, l->handleBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, tex->slot * sizeof(GLuint64), sizeof(GLuint64), &handle);
+}
+
+static void finish(texloader *l, texture *tex, unsigned int id)
+{
+    // swap the placeholder out for the real, immutable texture
+    tex->id = id;
+    publish_handle(l, tex);
+    atomic_store(&tex->state, TEXTURE_READY);
+}
+
+/*
+ * Uploads
+ */
+
+static void upload_compressed(texloader *l, texture *tex)
+{
+    const ddsinfo *dds = &tex->dds;
+
+    if (dds->format != GL_COMPRESSED_RGBA_BPTC_UNORM && !GLAD_GL_EXT_texture_compression_s3tc) {
+        fprintf(stderr, "No s3tc support for %s.\n", tex->path);
+        fail(tex);
+        return;
+    }
+
+    size_t size = 0;
+    for (int i = 0; i < dds->levels; i++)
+        size += dds_levelSize(dds, i);
+
+    // the whole chain goes through one pixel unpack buffer
+    unsigned int pbo;
+    glGenBuffers(1, &pbo);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, tex->file + dds->dataOffset, GL_STREAM_DRAW);
+
+    // direct state access throughout, uploads leave the texture bindings alone
+    unsigned int id;
+    glCreateTextures(GL_TEXTURE_2D, 1, &id);
+    glTextureStorage2D(id, dds->levels, dds->format, dds->width, dds->height);
+
+    size_t offset = 0;
+    for (int i = 0; i < dds->levels; i++) {
+        int w = dds->width >> i, h = dds->height >> i;
+        size_t levelSize = dds_levelSize(dds, i);
+
+        glCompressedTextureSubImage2D(id, i, 0, 0, w > 1 ? w : 1, h > 1 ? h : 1, dds->format, levelSize, (void *) offset);
+        offset += levelSize;
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glDeleteBuffers(1, &pbo);
+
+    unmap_file(tex);
+
+    finish(l, tex, id);
+}
+
+// map a pixel unpack buffer for a sized image's mip chain and hand it to a worker
+static void stage(texloader *l, texture *tex)
+{
+    // one byte of slack for jpeg output, see decode
+    size_t size = mip_chainSize(tex->width, tex->height, tex->channels) + 1;
+
+    // the worker reads each level back to build the next, so the mapping is
+    // readable too: drivers then hand out cached memory, not write-combined
+    glGenBuffers(1, &tex->pbo);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, tex->pbo);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+    tex->staging = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_READ_BIT | GL_MAP_WRITE_BIT);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (tex->staging == NULL) {
+        fprintf(stderr, "Failed to map pixel buffer for %s.\n", tex->path);
+        glDeleteBuffers(1, &tex->pbo);
+        tex->pbo = 0;
+        fail(tex);
+        return;
+    }
+
+    // the worker writes through the mapping, no gl calls leave this thread
+    atomic_store(&tex->state, TEXTURE_PENDING);
+    pool_submit(&l->workers, decode, tex);
+}
+
+static void release_staging(texture *tex)
+{
+    // deleting a mapped buffer unmaps it
+    glDeleteBuffers(1, &tex->pbo);
+    tex->pbo = 0;
+    tex->staging = NULL;
+}
+
+static void upload(texloader *l, texture *tex)
+{
+    if (tex->compressed) {
+        upload_compressed(l, tex);
+        return;
+    }
+
+    // grey and grey + alpha stay one and two channels, swizzled back to
+    // grey when sampled
+    static const GLenum formats[] = { 0, GL_RED, GL_RG, 0, GL_RGBA };
+    static const GLenum internalFormats[] = { 0, GL_R8, GL_RG8, 0, GL_RGBA8 };
+    static const GLint swizzles[][4] = {
+        { 0 },
+        { GL_RED, GL_RED, GL_RED, GL_ONE },
+        { GL_RED, GL_RED, GL_RED, GL_GREEN },
+    };
+
+    // the pixels are already in the buffer, the driver copies from it to the
+    // texture asynchronously instead of from client memory
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, tex->pbo);
+    if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) {
+        tex->staging = NULL;
+
+        unsigned int id;
+        glCreateTextures(GL_TEXTURE_2D, 1, &id);
+        int levels = mip_levelCount(tex->width, tex->height);
+        glTextureStorage2D(id, levels, internalFormats[tex->channels], tex->width, tex->height);
+        if (tex->channels < 3)
+            glTextureParameteriv(id, GL_TEXTURE_SWIZZLE_RGBA, swizzles[tex->channels]);
+
+        // every level comes from the worker's chain, tightly packed
+        size_t offset = 0;
+        for (int i = 0; i < levels; i++) {
+            int w = tex->width >> i, h = tex->height >> i;
+            w = w > 1 ? w : 1;
+            h = h > 1 ? h : 1;
+
+            glPixelStorei(GL_UNPACK_ALIGNMENT, row_alignment(w, tex->channels));
+            glTextureSubImage2D(id, i, 0, 0, w, h, formats[tex->channels], GL_UNSIGNED_BYTE, (void *) offset);
+            offset += (size_t) w * h * tex->channels;
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        finish(l, tex, id);
+    } else {
+        // the mapping was lost (e.g. a mode switch), the contents are undefined
+        fprintf(stderr, "Pixel buffer for %s was corrupted.\n", tex->path);
+        atomic_store(&tex->state, TEXTURE_FAILED);
+    }
+
+    // the buffer stays alive until the pending copy is done
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    release_staging(tex);
+}
+
+int texture_loaderCreate(texloader *l, int threads)
+{
+    l->textures = NULL;
+    l->len = l->cap = 0;
+    l->handles = NULL;
+    l->handleCap = 0;
+    l->handleBuffer = 0;
+    l->bindless = GLAD_GL_ARB_bindless_texture;
+
+    // 2x2 grey checker shown until the real images arrive
+    static const unsigned char checker[] = {
+        0x80, 0x80, 0x80,  0x40, 0x40, 0x40,
+        0x40, 0x40, 0x40,  0x80, 0x80, 0x80
+    };
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &l->placeholder);
+    glTextureStorage2D(l->placeholder, 2, GL_RGB8, 2, 2);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTextureSubImage2D(l->placeholder, 0, 0, 0, 2, 2, GL_RGB, GL_UNSIGNED_BYTE, checker);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateTextureMipmap(l->placeholder);
+
+    if (l->bindless) {
+        l->placeholderHandle = glGetTextureHandleARB(l->placeholder);
+        glMakeTextureHandleResidentARB(l->placeholderHandle);
+        glGenBuffers(1, &l->handleBuffer);
+    }
+
+    if (!pool_create(&l->workers, threads))
+        return 0;
+
+    stbi_set_parallel_for(parallel_decode, &l->workers);
+    return 1;
+}
+
+texture *texture_load(texloader *l, const char *path, int srgb)
+{
+    texture *tex = (texture *) malloc(sizeof(texture));
+    tex->id = l->placeholder;
+    tex->path = strdup(path);
+    tex->width = tex->height = tex->channels = 0;
+    tex->file = NULL;
+    tex->fileSize = 0;
+    tex->pbo = 0;
+    tex->staging = NULL;
+    tex->workers = &l->workers;
+    tex->compressed = has_extension(path, ".dds");
+    tex->srgb = srgb;
+    atomic_init(&tex->state, TEXTURE_PENDING);
+
+    if (l->len == l->cap) {
+        l->cap = l->cap ? l->cap * 2 : 8;
+        l->textures = (texture **) realloc(l->textures, l->cap * sizeof(texture *));
+    }
+    tex->slot = l->len;
+    l->textures[l->len++] = tex;
+
+    publish_handle(l, tex);
+
+    pool_submit(&l->workers, read_header, tex);
+    return tex;
+}
+
+int texture_update(texloader *l)
+{
+    int pending = 0;
+
+    for (int i = 0; i < l->len; i++) {
+        texture *tex = l->textures[i];
+        int state = atomic_load(&tex->state);
+
+        if (state == TEXTURE_SIZED) {
+            stage(l, tex);
+            pending++;
+        } else if (state == TEXTURE_DECODED) {
+            upload(l, tex);
+        } else if (state == TEXTURE_PENDING) {
+            pending++;
+        } else if (state == TEXTURE_FAILED && tex->pbo) {
+            release_staging(tex);
+        }
+    }
+
+    return pending;
+}
+
+void texture_loaderDestroy(texloader *l)
+{
+    // let in-flight decodes finish before freeing what they write to
+    pool_destroy(&l->workers);
+    stbi_set_parallel_for(NULL, NULL);
+
+    for (int i = 0; i < l->len; i++) {
+        texture *tex = l->textures[i];
+
+        if (tex->id != l->placeholder) {
+            if (l->bindless)
+                glMakeTextureHandleNonResidentARB(l->handles[tex->slot]);
+            glDeleteTextures(1, &tex->id);
+        }
+
+        if (tex->pbo) release_staging(tex);
+        unmap_file(tex);
+        free(tex->path);
+        free(tex);
+    }
+
+    if (l->bindless) {
+        glMakeTextureHandleNonResidentARB(l->placeholderHandle);
+        glDeleteBuffers(1, &l->handleBuffer);
+    }
+    glDeleteTextures(1, &l->placeholder);
+
+    free(l->handles);
+    free(l->textures);
+    l->handles = NULL;
+    l->textures = NULL;
+    l->len = l->cap = 0;
+}
@@ -0,0 +1,200 @@
+#include <vertex.h>
+#include <string.h>
+
+// bytes taken by one attribute, padded to 4 bytes
+static int attr_size(GLenum type, int components)
+{
+    switch (type) {
+        case GL_FLOAT:          return components * 4;
+        case GL_HALF_FLOAT:
+        case GL_SHORT:
+        case GL_UNSIGNED_SHORT: return (components * 2 + 3) & ~3;
+        default:                return 0;
+    }
+}
+
+int vertex_srcStride(const vertexformat *fmt)
+{
+    return fmt->normal != GL_NONE ? 8 : 5;
+}
+
+int vertex_stride(const vertexformat *fmt)
+{
+    return attr_size(fmt->position, 3)
+         + attr_size(fmt->texcoord, 2)
+         + (fmt->normal == GL_SHORT ? 4 : attr_size(fmt->normal, 3));
+}
+
+uint16_t vertex_toHalf(float f)
+{
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+
+    uint32_t sign = (x >> 16) & 0x8000;
+    int32_t exp = ((x >> 23) & 0xFF) - 127 + 15;
+    uint32_t mant = x & 0x7FFFFF;
+
+    // nan/inf, overflow, and values too small even for a denormal
+    if (((x >> 23) & 0xFF) == 0xFF) return sign | 0x7C00 | (mant ? 0x200 : 0);
+    if (exp >= 31) return sign | 0x7C00;
+    if (exp <= -10) return sign;
+
+    // denormal: shift the implicit bit in, round to nearest
+    if (exp <= 0) {
+        mant |= 0x800000;
+        int shift = 14 - exp;
+        uint32_t half = mant >> shift;
+        if ((mant >> (shift - 1)) & 1) half++;
+        return sign | half;
+    }
+
+    // round to nearest, a carry into the exponent is still correct
+    uint32_t half = sign | (exp << 10) | (mant >> 13);
+    if (mant & 0x1000) half++;
+    return half;
+}
+
+float vertex_fromHalf(uint16_t h)
+{
+    uint32_t sign = (uint32_t) (h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1F;
+    uint32_t mant = h & 0x3FF;
+
+    // denormals are exact as floats, inf/nan keep their payload
+    if (exp == 0) {
+        float f = ldexpf((float) mant, -24);
+        return sign ? -f : f;
+    }
+
+    uint32_t x = sign | (exp == 31 ? 0x7F800000 | (mant << 13) : ((exp + 127 - 15) << 23) | (mant << 13));
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+void vertex_octEncode(const float n[3], int16_t out[2])
+{
+    // project onto the octahedron, fold the lower half over the diagonals
+    float l1 = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+    if (l1 == 0.0f) {
+        // a zero normal has no direction, store +z
+        out[0] = out[1] = 0;
+        return;
+    }
+
+    float x = n[0] / l1, y = n[1] / l1;
+
+    if (n[2] < 0) {
+        float fx = (1.0f - fabsf(y)) * (x >= 0 ? 1.0f : -1.0f);
+        float fy = (1.0f - fabsf(x)) * (y >= 0 ? 1.0f : -1.0f);
+        x = fx;
+        y = fy;
+    }
+
+    out[0] = (int16_t) lroundf(x * 32767.0f);
+    out[1] = (int16_t) lroundf(y * 32767.0f);
+}
+
+// position of one packed vertex as stored, before posScale/posOffset
+void vertex_position(const vertexformat *fmt, const void *vertex, float out[3])
+{
+    for (int c = 0; c < 3; c++) {
+        switch (fmt->position) {
+            case GL_FLOAT:      out[c] = ((const float *) vertex)[c]; break;
+            case GL_HALF_FLOAT: out[c] = vertex_fromHalf(((const uint16_t *) vertex)[c]); break;
+            case GL_SHORT:      out[c] = fmaxf(((const int16_t *) vertex)[c] / 32767.0f, -1.0f); break;
+            default:            out[c] = 0.0f; break;
+        }
+    }
+}
+
+void vertex_pack(vertexformat *fmt, const float *src, int count, int srcStride, void *dst, float scale[3], float offset[3])
+{
+    int stride = vertex_stride(fmt);
+
+    // bounds, for the position dequantisation and the texcoord range check
+    float min[5], max[5];
+    for (int c = 0; c < 5; c++) {
+        min[c] = INFINITY;
+        max[c] = -INFINITY;
+    }
+
+    for (int i = 0; i < count; i++) {
+        for (int c = 0; c < 5; c++) {
+            float v = src[i * srcStride + c];
+            if (v < min[c]) min[c] = v;
+            if (v > max[c]) max[c] = v;
+        }
+    }
+
+    for (int c = 0; c < 3; c++) {
+        if (fmt->position == GL_SHORT) {
+            offset[c] = (min[c] + max[c]) * 0.5f;
+            scale[c] = (max[c] - min[c]) * 0.5f;
+            if (scale[c] == 0) scale[c] = 1.0f;
+        } else {
+            offset[c] = 0.0f;
+            scale[c] = 1.0f;
+        }
+    }
+
+    // unorm16 can only hold [0, 1], wrapping texcoords fall back to half
+    if (fmt->texcoord == GL_UNSIGNED_SHORT && (min[3] < 0 || min[4] < 0 || max[3] > 1 || max[4] > 1))
+        fmt->texcoord = GL_HALF_FLOAT;
+
+    for (int i = 0; i < count; i++) {
+        const float *v = src + i * srcStride;
+        unsigned char *out = (unsigned char *) dst + i * stride;
+
+        // position
+        for (int c = 0; c < 3; c++) {
+            float p = v[c];
+            switch (fmt->position) {
+                case GL_FLOAT:      ((float *) out)[c] = p; break;
+                case GL_HALF_FLOAT: ((uint16_t *) out)[c] = vertex_toHalf(p); break;
+                case GL_SHORT:      ((int16_t *) out)[c] = (int16_t) lroundf((p - offset[c]) / scale[c] * 32767.0f); break;
+            }
+        }
+        if (fmt->position != GL_FLOAT) ((int16_t *) out)[3] = 0;
+        out += attr_size(fmt->position, 3);
+
+        // texcoord
+        for (int c = 0; c < 2; c++) {
+            float t = v[3 + c];
+            switch (fmt->texcoord) {
+                case GL_FLOAT:          ((float *) out)[c] = t; break;
+                case GL_HALF_FLOAT:     ((uint16_t *) out)[c] = vertex_toHalf(t); break;
+                case GL_UNSIGNED_SHORT: ((uint16_t *) out)[c] = (uint16_t) lroundf(t * 65535.0f); break;
+            }
+        }
+        out += attr_size(fmt->texcoord, 2);
+
+        // normal
+        if (fmt->normal == GL_FLOAT)
+            memcpy(out, v + 5, 3 * sizeof(float));
+        else if (fmt->normal == GL_SHORT)
+            vertex_octEncode(v + 5, (int16_t *) out);
+    }
+}
+
+void vertex_bind(const vertexformat *fmt)
+{
+    int stride = vertex_stride(fmt);
+    size_t offset = 0;
+
+    // integer types are normalized, so the shader still reads floats
+    glVertexAttribPointer(VERTEX_ATTR_POSITION, 3, fmt->position, fmt->position == GL_SHORT, stride, (void *) offset);
+    glEnableVertexAttribArray(VERTEX_ATTR_POSITION);
+    offset += attr_size(fmt->position, 3);
+
+    glVertexAttribPointer(VERTEX_ATTR_TEXCOORD, 2, fmt->texcoord, fmt->texcoord == GL_UNSIGNED_SHORT, stride, (void *) offset);
+    glEnableVertexAttribArray(VERTEX_ATTR_TEXCOORD);
+    offset += attr_size(fmt->texcoord, 2);
+
+    // octahedral normals arrive as a vec2, vertex.glsl unfolds them when octNormals is set
+    if (fmt->normal != GL_NONE) {
+        int components = fmt->normal == GL_SHORT ? 2 : 3;
+        glVertexAttribPointer(VERTEX_ATTR_NORMAL, components, fmt->normal, fmt->normal == GL_SHORT, stride, (void *) offset);
+        glEnableVertexAttribArray(VERTEX_ATTR_NORMAL);
+    }
+}
@@ -0,0 +1,111 @@
+#include <watch.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
+
+int watch_create(watcher *w)
+{
+    w->files = NULL;
+    w->len = 0;
+    w->cap = 0;
+
+    w->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (w->fd < 0) {
+        perror("Failed to create file watcher.");
+        return 0;
+    }
+
+    return 1;
+}
+
+// returns an index identifying the file in watch_poll, or -1.
+// adding the same file again returns its existing index
+int watch_add(watcher *w, const char *path)
+{
+    if (w->fd < 0)
+        return -1;
+
+    // split into directory and file name
+    const char *slash = strrchr(path, '/');
+    char dir[512];
+    if (slash == NULL) {
+        strcpy(dir, ".");
+    } else {
+        size_t n = slash - path;
+        if (n == 0) n = 1;
+        if (n >= sizeof(dir)) return -1;
+        memcpy(dir, path, n);
+        dir[n] = '\0';
+    }
+
+    // watching the same directory twice returns the same descriptor
+    int wd = inotify_add_watch(w->fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (wd < 0) {
+        perror("Failed to watch directory.");
+        return -1;
+    }
+
+    const char *name = slash ? slash + 1 : path;
+    for (int i = 0; i < w->len; i++) {
+        if (w->files[i].wd == wd && strcmp(w->files[i].name, name) == 0)
+            return i;
+    }
+
+    if (w->len == w->cap) {
+        w->cap = w->cap ? w->cap * 2 : 8;
+        w->files = (watchfile *) realloc(w->files, w->cap * sizeof(watchfile));
+    }
+
+    watchfile *file = &w->files[w->len];
+    file->wd = wd;
+    file->name = strdup(name);
+
+    return w->len++;
+}
+
+// calls fn for every watched file that changed, returns the number of events
+int watch_poll(watcher *w, watch_fn fn, void *user)
+{
+    if (w->fd < 0)
+        return 0;
+
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int count = 0;
+
+    for (;;) {
+        ssize_t len = read(w->fd, buf, sizeof(buf));
+        if (len <= 0)
+            break;
+
+        for (char *ptr = buf; ptr < buf + len; ) {
+            const struct inotify_event *event = (const struct inotify_event *) ptr;
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            if (event->len == 0)
+                continue;
+
+            for (int i = 0; i < w->len; i++) {
+                if (w->files[i].wd == event->wd && strcmp(w->files[i].name, event->name) == 0) {
+                    fn(i, user);
+                    count++;
+                }
+            }
+        }
+    }
+
+    return count;
+}
+
+void watch_destroy(watcher *w)
+{
+    for (int i = 0; i < w->len; i++)
+        free(w->files[i].name);
+    free(w->files);
+    w->files = NULL;
+    w->len = w->cap = 0;
+
+    if (w->fd >= 0)
+        close(w->fd);
+    w->fd = -1;
+}
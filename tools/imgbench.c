@@ -0,0 +1,121 @@
+/*
+ * imgbench.c
+ * decode-throughput benchmark for the bundled stb_image. the file is read
+ * into memory once and decoded repeatedly at every jpeg simd level
+ * (0 scalar, 1 sse2, 2 avx2, 3 avx-512), one json line per level.
+ * levels the cpu doesn't support fall back to the best available one.
+ * with threads > 1, large images are split across a thread pool.
+ *
+ * usage: imgbench in.jpg [iterations] [threads]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "pool.h"
+#include "stb_image.h"
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void parallel_decode(stbi_parallel_task task, void *ctx, int count, void *user)
+{
+    pool_parallelFor((pool *) user, task, ctx, count);
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+static unsigned char *read_file(const char *path, int *len)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) return NULL;
+
+    fseek(fp, 0, SEEK_END);
+    *len = (int) ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    unsigned char *data = (unsigned char *) malloc(*len);
+    if (fread(data, 1, *len, fp) != (size_t) *len) {
+        free(data);
+        data = NULL;
+    }
+
+    fclose(fp);
+    return data;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s in.jpg [iterations] [threads]\n", argv[0]);
+        return 1;
+    }
+
+    int iterations = argc > 2 ? atoi(argv[2]) : 50;
+    if (iterations < 1) iterations = 1;
+
+    int threads = argc > 3 ? atoi(argv[3]) : 1;
+    pool workers;
+    if (threads > 1 && pool_create(&workers, threads))
+        stbi_set_parallel_for(parallel_decode, &workers);
+    else
+        threads = 1;
+
+    int len;
+    unsigned char *file = read_file(argv[1], &len);
+    if (file == NULL) {
+        fprintf(stderr, "Failed to read %s.\n", argv[1]);
+        return 1;
+    }
+
+    double *times = (double *) malloc(iterations * sizeof(double));
+
+    for (int level = 0; level <= 3; level++) {
+        stbi_set_jpeg_simd_level(level);
+
+        int w = 0, h = 0, channels;
+        double total = 0;
+
+        for (int i = 0; i < iterations; i++) {
+            double start = now();
+            unsigned char *pixels = stbi_load_from_memory(file, len, &w, &h, &channels, 4);
+            times[i] = now() - start;
+
+            if (pixels == NULL) {
+                fprintf(stderr, "Failed to decode %s: %s\n", argv[1], stbi_failure_reason());
+                return 1;
+            }
+
+            stbi_image_free(pixels);
+            total += times[i];
+        }
+
+        qsort(times, iterations, sizeof(double), cmp_double);
+
+        double median = times[(iterations - 1) / 2];
+        printf("{\"level\": %d, \"threads\": %d, \"width\": %d, \"height\": %d, \"iterations\": %d, "
+               "\"min_ms\": %.4f, \"median_ms\": %.4f, \"mean_ms\": %.4f, \"mpix_per_sec\": %.1f}\n",
+               level, threads, w, h, iterations, times[0] * 1000.0, median * 1000.0,
+               total / iterations * 1000.0, median > 0 ? w * h / median * 1e-6 : 0.0);
+    }
+
+    if (threads > 1) {
+        stbi_set_parallel_for(NULL, NULL);
+        pool_destroy(&workers);
+    }
+
+    free(times);
+    free(file);
+
+    return 0;
+}
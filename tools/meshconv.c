@@ -0,0 +1,151 @@
+/*
+ * meshconv.c
+ * offline converter from wavefront .obj to the binary mesh cache.
+ * faces are triangulated as fans, then welded, reordered and packed.
+ *
+ * usage: meshconv in.obj out.mesh [--float]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "mesh.h"
+
+typedef struct {
+    float *data;
+    int len, cap;
+} floatlist;
+
+static void push(floatlist *l, const float *v, int n)
+{
+    if (l->len + n > l->cap) {
+        l->cap = l->cap ? l->cap * 2 : 1024;
+        if (l->cap < l->len + n) l->cap = l->len + n;
+        l->data = (float *) realloc(l->data, l->cap * sizeof(float));
+    }
+
+    memcpy(l->data + l->len, v, n * sizeof(float));
+    l->len += n;
+}
+
+// resolve a 1-based (or negative, relative) obj index
+static int resolve(int index, int count)
+{
+    if (index < 0) return count + index;
+    return index - 1;
+}
+
+// append one face corner "v", "v/vt", "v//vn" or "v/vt/vn" as a full vertex
+static int emit(floatlist *out, const char *corner, floatlist *pos, floatlist *uv, floatlist *nrm, int normals)
+{
+    int v = 0, t = 0, n = 0;
+    float vert[8] = { 0 };
+
+    if (sscanf(corner, "%d/%d/%d", &v, &t, &n) != 3
+            && sscanf(corner, "%d//%d", &v, &n) != 2
+            && sscanf(corner, "%d/%d", &v, &t) != 2
+            && sscanf(corner, "%d", &v) != 1)
+        return 0;
+
+    v = resolve(v, pos->len / 3);
+    if (v < 0 || v >= pos->len / 3) return 0;
+    memcpy(vert, pos->data + v * 3, 3 * sizeof(float));
+
+    if (t) {
+        t = resolve(t, uv->len / 2);
+        if (t < 0 || t >= uv->len / 2) return 0;
+        memcpy(vert + 3, uv->data + t * 2, 2 * sizeof(float));
+    }
+
+    // once the mesh has normals, every corner needs one
+    if (normals && !n) return 0;
+
+    if (n) {
+        n = resolve(n, nrm->len / 3);
+        if (n < 0 || n >= nrm->len / 3) return 0;
+        memcpy(vert + 5, nrm->data + n * 3, 3 * sizeof(float));
+    }
+
+    push(out, vert, normals ? 8 : 5);
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s in.obj out.mesh [--float]\n", argv[0]);
+        return 1;
+    }
+
+    vertexformat format = VERTEXFORMAT_COMPACT;
+    if (argc > 3 && strcmp(argv[3], "--float") == 0)
+        format = VERTEXFORMAT_FLOAT;
+
+    FILE *fp = fopen(argv[1], "r");
+    if (fp == NULL) {
+        perror("Failed to open file.");
+        return 1;
+    }
+
+    floatlist pos = { 0 }, uv = { 0 }, nrm = { 0 }, tris = { 0 };
+    char line[1024];
+
+    // first pass: attribute pools, to know whether the mesh has normals
+    while (fgets(line, sizeof(line), fp)) {
+        float v[3];
+        if (sscanf(line, "v %f %f %f", &v[0], &v[1], &v[2]) == 3)        push(&pos, v, 3);
+        else if (sscanf(line, "vt %f %f", &v[0], &v[1]) == 2)            push(&uv, v, 2);
+        else if (sscanf(line, "vn %f %f %f", &v[0], &v[1], &v[2]) == 3)  push(&nrm, v, 3);
+    }
+
+    int normals = nrm.len > 0;
+    if (normals && format.position != GL_FLOAT)
+        format.normal = GL_SHORT;
+    else if (normals)
+        format.normal = GL_FLOAT;
+
+    // second pass: triangulate faces into a flat triangle list
+    rewind(fp);
+    int lineNo = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        lineNo++;
+        if (strncmp(line, "f ", 2) != 0) continue;
+
+        char *corners[64];
+        int count = 0;
+        for (char *tok = strtok(line + 2, " \t\r\n"); tok && count < 64; tok = strtok(NULL, " \t\r\n"))
+            corners[count++] = tok;
+
+        for (int i = 1; i + 1 < count; i++) {
+            if (!emit(&tris, corners[0], &pos, &uv, &nrm, normals)
+                    || !emit(&tris, corners[i], &pos, &uv, &nrm, normals)
+                    || !emit(&tris, corners[i + 1], &pos, &uv, &nrm, normals)) {
+                fprintf(stderr, "%s:%d: bad face.\n", argv[1], lineNo);
+                fclose(fp);
+                return 1;
+            }
+        }
+    }
+    fclose(fp);
+
+    int stride = normals ? 8 : 5;
+    mesh m;
+    if (!mesh_create(&m, tris.data, tris.len / stride, stride))
+        return 1;
+
+    mesh_pack(&m, format);
+    if (!mesh_save(&m, argv[2]))
+        return 1;
+
+    printf("%s: %d triangles, %d -> %d vertices, %d bytes per vertex\n",
+        argv[2], m.indexCount / 3, tris.len / stride, m.vertexCount, vertex_stride(&m.format));
+
+    mesh_destroy(&m);
+    free(pos.data);
+    free(uv.data);
+    free(nrm.data);
+    free(tris.data);
+
+    return 0;
+}
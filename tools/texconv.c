@@ -0,0 +1,377 @@
+/*
+ * texconv.c
+ * offline texture compressor: decodes an image, builds the full mip chain
+ * with the same filter as the runtime loader (see mip.h) and
+ * block-compresses every level into a .dds file. images are treated as
+ * colour and filtered in linear light unless 'linear' is given.
+ *
+ * bc1: opaque rgb, 4 bits per pixel.
+ * bc3: rgb + interpolated alpha, 8 bits per pixel.
+ * bc7: mode 6 only (single subset rgba, 7-bit endpoints + p-bit, 4-bit
+ *      indices), 8 bits per pixel at much better quality than bc1/bc3.
+ *
+ * usage: texconv in.jpg out.dds [bc1|bc3|bc7] [linear]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "dds.h"
+#include "mip.h"
+#include "stb_image.h"
+
+/*
+ * Shared block fitting
+ */
+
+static float clampf(float v, float lo, float hi)
+{
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+// copy a 4x4 block out of an rgba8 image, clamping at the edges
+static void fetch_block(const unsigned char *img, int w, int h, int bx, int by, float px[16][4])
+{
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+            int sx = bx * 4 + x < w ? bx * 4 + x : w - 1;
+            int sy = by * 4 + y < h ? by * 4 + y : h - 1;
+            const unsigned char *p = img + ((size_t) sy * w + sx) * 4;
+
+            for (int c = 0; c < 4; c++)
+                px[y * 4 + x][c] = p[c];
+        }
+    }
+}
+
+// endpoints along the principal axis of the block (power iteration on the covariance)
+static void fit_line(float px[16][4], int channels, float e0[4], float e1[4])
+{
+    float mean[4] = { 0 }, cov[4][4] = { { 0 } }, axis[4] = { 1, 1, 1, 1 };
+
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < channels; c++)
+            mean[c] += px[i][c] / 16.0f;
+
+    for (int i = 0; i < 16; i++)
+        for (int a = 0; a < channels; a++)
+            for (int b = 0; b < channels; b++)
+                cov[a][b] += (px[i][a] - mean[a]) * (px[i][b] - mean[b]);
+
+    for (int iter = 0; iter < 8; iter++) {
+        float next[4] = { 0 }, len = 0;
+        for (int a = 0; a < channels; a++) {
+            for (int b = 0; b < channels; b++)
+                next[a] += cov[a][b] * axis[b];
+            len += next[a] * next[a];
+        }
+
+        // flat block, any axis will do
+        if (len < 1e-6f) break;
+
+        len = sqrtf(len);
+        for (int a = 0; a < channels; a++)
+            axis[a] = next[a] / len;
+    }
+
+    float lo = INFINITY, hi = -INFINITY;
+    for (int i = 0; i < 16; i++) {
+        float t = 0;
+        for (int c = 0; c < channels; c++)
+            t += (px[i][c] - mean[c]) * axis[c];
+        if (t < lo) lo = t;
+        if (t > hi) hi = t;
+    }
+
+    for (int c = 0; c < channels; c++) {
+        e0[c] = clampf(mean[c] + axis[c] * hi, 0, 255);
+        e1[c] = clampf(mean[c] + axis[c] * lo, 0, 255);
+    }
+}
+
+static int nearest(const float p[4], float palette[][4], int count, int channels)
+{
+    int best = 0;
+    float bestErr = INFINITY;
+
+    for (int i = 0; i < count; i++) {
+        float err = 0;
+        for (int c = 0; c < channels; c++)
+            err += (p[c] - palette[i][c]) * (p[c] - palette[i][c]);
+        if (err < bestErr) {
+            bestErr = err;
+            best = i;
+        }
+    }
+
+    return best;
+}
+
+/*
+ * BC1 / BC3
+ */
+
+static uint16_t to565(const float c[3])
+{
+    int r = (int) lroundf(c[0] * 31.0f / 255.0f);
+    int g = (int) lroundf(c[1] * 63.0f / 255.0f);
+    int b = (int) lroundf(c[2] * 31.0f / 255.0f);
+    return (r << 11) | (g << 5) | b;
+}
+
+static void from565(uint16_t v, float c[4])
+{
+    int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+    c[0] = (r << 3) | (r >> 2);
+    c[1] = (g << 2) | (g >> 4);
+    c[2] = (b << 3) | (b >> 2);
+    c[3] = 255;
+}
+
+static void encode_bc1(float px[16][4], unsigned char out[8])
+{
+    float e0[4], e1[4];
+    fit_line(px, 3, e0, e1);
+
+    uint16_t c0 = to565(e0), c1 = to565(e1);
+
+    // four-colour mode needs c0 > c1; equal endpoints just use index 0
+    if (c0 < c1) {
+        uint16_t t = c0;
+        c0 = c1;
+        c1 = t;
+    }
+
+    float palette[4][4];
+    from565(c0, palette[0]);
+    from565(c1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3.0f;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3.0f;
+    }
+
+    uint32_t indices = 0;
+    if (c0 != c1)
+        for (int i = 0; i < 16; i++)
+            indices |= (uint32_t) nearest(px[i], palette, 4, 3) << (i * 2);
+
+    out[0] = c0 & 0xFF;
+    out[1] = c0 >> 8;
+    out[2] = c1 & 0xFF;
+    out[3] = c1 >> 8;
+    for (int i = 0; i < 4; i++)
+        out[4 + i] = (indices >> (i * 8)) & 0xFF;
+}
+
+static void encode_alpha(float px[16][4], unsigned char out[8])
+{
+    float lo = 255, hi = 0;
+    for (int i = 0; i < 16; i++) {
+        if (px[i][3] < lo) lo = px[i][3];
+        if (px[i][3] > hi) hi = px[i][3];
+    }
+
+    int a0 = (int) lroundf(hi), a1 = (int) lroundf(lo);
+
+    // a0 > a1 selects the eight-value ramp
+    float palette[8][4] = { { 0 } };
+    palette[0][0] = a0;
+    palette[1][0] = a1;
+    for (int i = 2; i < 8; i++)
+        palette[i][0] = ((8 - i) * a0 + (i - 1) * a1) / 7.0f;
+
+    uint64_t indices = 0;
+    if (a0 != a1) {
+        for (int i = 0; i < 16; i++) {
+            float a[4] = { px[i][3] };
+            indices |= (uint64_t) nearest(a, palette, 8, 1) << (i * 3);
+        }
+    }
+
+    out[0] = a0;
+    out[1] = a1;
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = (indices >> (i * 8)) & 0xFF;
+}
+
+static void encode_bc3(float px[16][4], unsigned char out[16])
+{
+    encode_alpha(px, out);
+    encode_bc1(px, out + 8);
+}
+
+/*
+ * BC7 mode 6
+ */
+
+static const int bc7_weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+static void put_bits(unsigned char out[16], int *pos, uint32_t v, int n)
+{
+    for (int i = 0; i < n; i++, (*pos)++)
+        if ((v >> i) & 1)
+            out[*pos >> 3] |= 1 << (*pos & 7);
+}
+
+// quantise an endpoint to 7 bits per channel plus a shared p-bit
+static void quantize_bc7(const float e[4], int q[4], int *pbit)
+{
+    float bestErr = INFINITY;
+
+    for (int p = 0; p < 2; p++) {
+        int cand[4];
+        float err = 0;
+        for (int c = 0; c < 4; c++) {
+            cand[c] = (int) clampf(lroundf((e[c] - p) / 2.0f), 0, 127);
+            float v = (cand[c] << 1) | p;
+            err += (v - e[c]) * (v - e[c]);
+        }
+
+        if (err < bestErr) {
+            bestErr = err;
+            *pbit = p;
+            memcpy(q, cand, sizeof(cand));
+        }
+    }
+}
+
+static void encode_bc7(float px[16][4], unsigned char out[16])
+{
+    float e0[4], e1[4];
+    fit_line(px, 4, e0, e1);
+
+    int q[2][4], p[2];
+    quantize_bc7(e0, q[0], &p[0]);
+    quantize_bc7(e1, q[1], &p[1]);
+
+    float palette[16][4];
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 4; c++) {
+            int a = (q[0][c] << 1) | p[0];
+            int b = (q[1][c] << 1) | p[1];
+            palette[i][c] = ((64 - bc7_weights[i]) * a + bc7_weights[i] * b + 32) >> 6;
+        }
+    }
+
+    int idx[16];
+    for (int i = 0; i < 16; i++)
+        idx[i] = nearest(px[i], palette, 16, 4);
+
+    // the anchor index has an implicit zero msb, swap endpoints to make it so
+    if (idx[0] & 8) {
+        for (int c = 0; c < 4; c++) {
+            int t = q[0][c];
+            q[0][c] = q[1][c];
+            q[1][c] = t;
+        }
+        int t = p[0];
+        p[0] = p[1];
+        p[1] = t;
+
+        for (int i = 0; i < 16; i++)
+            idx[i] = 15 - idx[i];
+    }
+
+    memset(out, 0, 16);
+    int pos = 0;
+
+    put_bits(out, &pos, 1 << 6, 7);
+    for (int c = 0; c < 4; c++) {
+        put_bits(out, &pos, q[0][c], 7);
+        put_bits(out, &pos, q[1][c], 7);
+    }
+    put_bits(out, &pos, p[0], 1);
+    put_bits(out, &pos, p[1], 1);
+
+    put_bits(out, &pos, idx[0], 3);
+    for (int i = 1; i < 16; i++)
+        put_bits(out, &pos, idx[i], 4);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s in.jpg out.dds [bc1|bc3|bc7] [linear]\n", argv[0]);
+        return 1;
+    }
+
+    int w, h, channels;
+    unsigned char *image = stbi_load(argv[1], &w, &h, &channels, 4);
+    if (image == NULL) {
+        fprintf(stderr, "Failed to load %s: %s\n", argv[1], stbi_failure_reason());
+        return 1;
+    }
+
+    // default: bc1 for opaque images, bc3 when there is alpha
+    GLenum format = channels == 2 || channels == 4 ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    if (argc > 3) {
+        if      (strcmp(argv[3], "bc1") == 0) format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        else if (strcmp(argv[3], "bc3") == 0) format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        else if (strcmp(argv[3], "bc7") == 0) format = GL_COMPRESSED_RGBA_BPTC_UNORM;
+        else {
+            fprintf(stderr, "Unknown format %s.\n", argv[3]);
+            return 1;
+        }
+    }
+
+    int srgb = !(argc > 4 && strcmp(argv[4], "linear") == 0);
+
+    ddsinfo info = { format, w, h, mip_levelCount(w, h), format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? 8 : 16, 0 };
+
+    // the whole chain up front, level 0 is the image
+    unsigned char *chain = (unsigned char *) malloc(mip_chainSize(w, h, 4));
+    memcpy(chain, image, (size_t) w * h * 4);
+    stbi_image_free(image);
+    mip_generate(NULL, chain, w, h, 4, srgb);
+    unsigned char *level = chain;
+
+    FILE *fp = fopen(argv[2], "wb");
+    if (fp == NULL) {
+        perror("Failed to open file.");
+        return 1;
+    }
+
+    if (!dds_writeHeader(fp, &info))
+        return 1;
+
+    size_t total = 0;
+    for (int l = 0; l < info.levels; l++) {
+        int bw = (w + 3) / 4, bh = (h + 3) / 4;
+        unsigned char *blocks = (unsigned char *) malloc((size_t) bw * bh * info.blockBytes);
+
+        for (int by = 0; by < bh; by++) {
+            for (int bx = 0; bx < bw; bx++) {
+                float px[16][4];
+                unsigned char *out = blocks + ((size_t) by * bw + bx) * info.blockBytes;
+
+                fetch_block(level, w, h, bx, by, px);
+                switch (format) {
+                    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:  encode_bc1(px, out); break;
+                    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: encode_bc3(px, out); break;
+                    default:                               encode_bc7(px, out); break;
+                }
+            }
+        }
+
+        fwrite(blocks, info.blockBytes, (size_t) bw * bh, fp);
+        total += (size_t) bw * bh * info.blockBytes;
+        free(blocks);
+
+        level += (size_t) w * h * 4;
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+    }
+
+    free(chain);
+
+    if (ferror(fp) | fclose(fp)) {
+        fprintf(stderr, "Failed to write %s.\n", argv[2]);
+        return 1;
+    }
+
+    printf("%s: %dx%d, %d levels, %zu bytes\n", argv[2], info.width, info.height, info.levels, total);
+    return 0;
+}